@@ -0,0 +1,270 @@
+#pragma once
+#include "grammarOptimizer.hpp"
+
+// the grammar in the format readCFG reads, nonterminals sorted, start symbol first
+void writeCFG(const Grammar& grammar, const std::string& start_symbol, std::ostream& out) {
+    std::vector<std::string> non_terminals;
+    for (const auto& entry : grammar) {
+        if (entry.first != start_symbol) non_terminals.push_back(entry.first);
+    }
+    std::sort(non_terminals.begin(), non_terminals.end());
+    if (grammar.count(start_symbol)) non_terminals.insert(non_terminals.begin(), start_symbol);
+
+    for (const auto& non_terminal : non_terminals) {
+        out << non_terminal << " ->";
+        const auto& productions = grammar.at(non_terminal);
+        for (int p = 0; p < productions.size(); p++) {
+            if (p) out << " |";
+            if (productions[p].empty()) out << " ε";
+            for (const auto& symbol : productions[p]) out << " " << symbol;
+        }
+        out << "\n";
+    }
+}
+
+struct CNFResult {
+    Grammar grammar;
+    std::string start_symbol;
+    bool accepts_empty = false; // CNF cannot hold S0 -> ε, CYK never sees an empty input anyway
+    GrammarSize before;
+    GrammarSize after;
+};
+
+/**
+ * @brief Convert any CFG into Chomsky Normal Form
+ * Procedure
+ * 1. START : a new start symbol S0 -> S, so the start never appears on a right side
+ * 2. TERM  : terminals inside rules of two or more symbols get a nonterminal T -> a,
+ *            a terminal of several characters is spelled out when CYK reads characters
+ *            and kept whole when it reads tokens
+ * 3. BIN   : A -> X1 X2 ... Xk becomes A -> X1 <X2..Xk>, <Xi..Xk> -> Xi <Xi+1..Xk>,
+ *            one intermediate per distinct suffix, shared by every rule ending with it
+ * 4. DEL   : nullable nonterminals by a worklist, then A -> B C also gives A -> B when
+ *            C is nullable and A -> C when B is nullable. Rules have at most two symbols
+ *            by now, so this never grows exponentially
+ * 5. UNIT  : A -> B chains are closed over the strongly connected components of the
+ *            unit graph, every member of a component shares one closure,
+ *            then A takes every non unit rule of every symbol it reaches
+ * 6. useless symbols are dropped by optimizeGrammar
+ *
+ * @param grammar as read by readCFG
+ * @param start_symbol
+ * @param spell_terminals false keeps multi character terminals as single tokens
+ * @return CNFResult whose grammar feeds CompiledGrammar and cyk() directly
+ */
+
+CNFResult toCNF(const Grammar& grammar, const std::string& start_symbol, bool spell_terminals = true) {
+    CNFResult result;
+    result.before = grammarSize(grammar);
+
+    std::unordered_set<std::string> used;
+    for (const auto& [non_terminal, productions] : grammar) {
+        used.insert(non_terminal);
+        for (const auto& prod : productions) used.insert(prod.begin(), prod.end());
+    }
+    auto fresh = [&](std::string name) {
+        while (used.count(name)) name += "'";
+        used.insert(name);
+        return name;
+    };
+
+    // rules in a deterministic order so that generated names do not depend on hashing
+    std::vector<std::string> order;
+    for (const auto& entry : grammar) order.push_back(entry.first);
+    std::sort(order.begin(), order.end());
+
+    std::map<std::string, std::vector<std::vector<std::string>>> rules;
+    auto isNonTerminal = [&](const std::string& symbol) { return rules.count(symbol) > 0; };
+
+    // START
+    std::string start = fresh(start_symbol + "0");
+    rules[start].push_back({start_symbol});
+    for (const auto& non_terminal : order) {
+        auto& target = rules[non_terminal];
+        for (const auto& prod : grammar.at(non_terminal)) {
+            if (isEpsilonProduction(prod)) target.push_back({});
+            else target.push_back(prod);
+        }
+    }
+    if (!grammar.count(start_symbol)) rules[start].clear();
+
+    // TERM
+    std::map<std::string, std::string> terminal_symbol;
+    auto terminalNonTerminal = [&](const std::string& terminal) {
+        auto it = terminal_symbol.find(terminal);
+        if (it != terminal_symbol.end()) return it->second;
+        std::string name = fresh("T_" + terminal);
+        terminal_symbol[terminal] = name;
+        return name;
+    };
+    std::vector<std::pair<std::string, std::string>> terminal_rules;
+    for (auto& [non_terminal, productions] : rules) {
+        for (auto& prod : productions) {
+            if (prod.size() == 1 && (isNonTerminal(prod[0]) || prod[0].size() == 1 || !spell_terminals)) continue;
+            std::vector<std::string> spelled;
+            for (const auto& symbol : prod) {
+                if (isNonTerminal(symbol) || !spell_terminals) {
+                    spelled.push_back(symbol);
+                } else {
+                    for (char c : symbol) spelled.push_back(std::string(1, c));
+                }
+            }
+            if (spelled.size() >= 2) {
+                for (auto& symbol : spelled) {
+                    if (!isNonTerminal(symbol)) symbol = terminalNonTerminal(symbol);
+                }
+            }
+            prod = spelled;
+        }
+    }
+    for (const auto& [terminal, non_terminal] : terminal_symbol) {
+        rules[non_terminal].push_back({terminal});
+    }
+
+    // BIN
+    std::map<std::vector<std::string>, std::string> suffix_symbol;
+    std::vector<std::pair<std::string, std::vector<std::string>>> suffix_rules;
+    std::function<std::string(const std::vector<std::string>&, int)> suffix = [&](const std::vector<std::string>& prod, int from) {
+        if (from == prod.size() - 1) return prod[from];
+        std::vector<std::string> key(prod.begin() + from, prod.end());
+        auto it = suffix_symbol.find(key);
+        if (it != suffix_symbol.end()) return it->second;
+        std::string name = "<";
+        for (int i = from; i < prod.size(); i++) name += (i > from ? "," : "") + prod[i];
+        name = fresh(name + ">");
+        suffix_symbol[key] = name;
+        std::string rest = suffix(prod, from + 1);
+        suffix_rules.push_back({name, {prod[from], rest}});
+        return name;
+    };
+    for (auto& [non_terminal, productions] : rules) {
+        for (auto& prod : productions) {
+            if (prod.size() > 2) prod = {prod[0], suffix(prod, 1)};
+        }
+    }
+    for (auto& [name, prod] : suffix_rules) {
+        rules[name].push_back(prod);
+    }
+
+    // DEL
+    std::set<std::string> nullable;
+    std::map<std::string, std::vector<std::pair<std::string, std::vector<std::string>>>> uses; // symbol -> rules mentioning it
+    std::vector<std::string> worklist;
+    for (const auto& [non_terminal, productions] : rules) {
+        for (const auto& prod : productions) {
+            if (prod.empty() && nullable.insert(non_terminal).second) worklist.push_back(non_terminal);
+            for (const auto& symbol : prod) uses[symbol].push_back({non_terminal, prod});
+        }
+    }
+    while (!worklist.empty()) {
+        std::string symbol = worklist.back();
+        worklist.pop_back();
+        for (const auto& [head, prod] : uses[symbol]) {
+            if (nullable.count(head)) continue;
+            bool all = true;
+            for (const auto& s : prod) all = all && nullable.count(s);
+            if (all) {
+                nullable.insert(head);
+                worklist.push_back(head);
+            }
+        }
+    }
+    result.accepts_empty = nullable.count(start) > 0;
+    for (auto& [non_terminal, productions] : rules) {
+        std::set<std::vector<std::string>> kept;
+        for (const auto& prod : productions) {
+            if (prod.empty()) continue;
+            kept.insert(prod);
+            if (prod.size() == 2) {
+                if (nullable.count(prod[1])) kept.insert({prod[0]});
+                if (nullable.count(prod[0])) kept.insert({prod[1]});
+            }
+        }
+        productions.assign(kept.begin(), kept.end());
+    }
+
+    // UNIT : Tarjan's algorithm over the unit graph, iterative
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> index_of;
+    for (const auto& entry : rules) {
+        index_of[entry.first] = names.size();
+        names.push_back(entry.first);
+    }
+    int count = names.size();
+    std::vector<std::vector<int>> unit_edges(count);
+    for (const auto& [non_terminal, productions] : rules) {
+        for (const auto& prod : productions) {
+            if (prod.size() == 1 && isNonTerminal(prod[0]) && prod[0] != non_terminal) {
+                unit_edges[index_of[non_terminal]].push_back(index_of[prod[0]]);
+            }
+        }
+    }
+
+    std::vector<int> component(count, -1), low(count), discovered(count, -1), tarjan_stack;
+    std::vector<bool> on_stack(count, false);
+    int components = 0, timer = 0;
+    for (int root = 0; root < count; root++) {
+        if (discovered[root] >= 0) continue;
+        std::vector<std::pair<int, int>> call_stack = {{root, 0}};
+        discovered[root] = low[root] = timer++;
+        tarjan_stack.push_back(root);
+        on_stack[root] = true;
+        while (!call_stack.empty()) {
+            auto& [v, edge] = call_stack.back();
+            if (edge < unit_edges[v].size()) {
+                int w = unit_edges[v][edge++];
+                if (discovered[w] < 0) {
+                    discovered[w] = low[w] = timer++;
+                    tarjan_stack.push_back(w);
+                    on_stack[w] = true;
+                    call_stack.push_back({w, 0});
+                } else if (on_stack[w]) {
+                    low[v] = std::min(low[v], discovered[w]);
+                }
+                continue;
+            }
+            int finished = v;
+            call_stack.pop_back();
+            if (!call_stack.empty()) {
+                int parent = call_stack.back().first;
+                low[parent] = std::min(low[parent], low[finished]);
+            }
+            if (low[finished] == discovered[finished]) {
+                while (true) {
+                    int w = tarjan_stack.back();
+                    tarjan_stack.pop_back();
+                    on_stack[w] = false;
+                    component[w] = components;
+                    if (w == finished) break;
+                }
+                components++;
+            }
+        }
+    }
+
+    // Tarjan numbers components in reverse topological order, successors come first
+    std::vector<std::vector<int>> members(components);
+    for (int v = 0; v < count; v++) members[component[v]].push_back(v);
+    std::vector<std::set<std::vector<std::string>>> closure(components);
+    for (int c = 0; c < components; c++) {
+        for (int v : members[c]) {
+            for (const auto& prod : rules[names[v]]) {
+                if (!(prod.size() == 1 && isNonTerminal(prod[0]))) closure[c].insert(prod);
+            }
+            for (int w : unit_edges[v]) {
+                if (component[w] != c) closure[c].insert(closure[component[w]].begin(), closure[component[w]].end());
+            }
+        }
+    }
+    for (int v = 0; v < count; v++) {
+        const auto& productions = closure[component[v]];
+        rules[names[v]].assign(productions.begin(), productions.end());
+    }
+
+    // nonterminals left without rules (only ε before DEL) and what no longer reaches them
+    Grammar converted(rules.begin(), rules.end());
+    result.grammar = optimizeGrammar(converted, start).grammar;
+    result.start_symbol = start;
+    result.after = grammarSize(result.grammar);
+    return result;
+}
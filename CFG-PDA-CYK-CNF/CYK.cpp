@@ -1,144 +1,236 @@
-#include <iostream>
-#include <fstream>
-#include<bits/stdc++.h>
+#include "batchCYK.hpp"
+#include "onlineCYK.hpp"
+#include "sppf.hpp"
+#include "incrementalCYK.hpp"
+#include "Earley.hpp"
+#include "valiantCYK.hpp"
+#include "LL1.hpp"
+#include "PDA.hpp"
+#include "tokenCYK.hpp"
+#include "viterbiCYK.hpp"
 
-std::unordered_map<std::string, std::vector<std::vector<std::string>>> readCFG(const std::string& filename) {
-    std::unordered_map<std::string, std::vector<std::vector<std::string>>> grammar;
-
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return grammar;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string non_terminal, arrow;
-        ss >> non_terminal >> arrow;
-        std::string symbol;
-        std::vector<std::string> production;
-        while (ss >> symbol) {
-            if (symbol == "|") {
-                grammar[non_terminal].push_back(production);
-                production.clear();
-            } else {
-                production.push_back(symbol);
-            }
+int main(int argc, char* argv[]) {
+    std::string filename = "cfg.txt"; 
+    std::string start_symbol = "S"; // --start X
+    int threads = -1; // --threads N fills the table diagonals in parallel, by default one thread, every hardware thread with --batch
+    bool batch = false; // --batch [file] checks one string per line, "-" or nothing reads stdin
+    bool online = false; // --online reads symbols from stdin and reports every prefix
+    bool cnf = false; // --cnf converts the grammar to Chomsky Normal Form first
+    bool edit = false; // --edit keeps the table while stdin edits the input
+    std::string engine = "cyk"; // --engine cyk|classic|valiant|earley|ll1|pda|viterbi, earley, ll1 and pda need no CNF
+    int beam = 0; // --beam K keeps the K best entries per cell with --engine viterbi, 0 keeps all
+    double threshold = std::numeric_limits<double>::infinity(); // --threshold T drops entries T below the best of their cell
+    int trees = -1; // --trees k prints the first k parse trees, the first one is drawn, by default 1, none with --engine earley
+    std::string batch_file = "-";
+    bool tokens = false; // --tokens [file] reads whitespace delimited tokens, each one terminal, "-" or nothing reads one line of stdin
+    std::string token_file = "-";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = std::stoi(argv[++i]);
+        else if (arg == "--grammar" && i + 1 < argc) filename = argv[++i];
+        else if (arg == "--start" && i + 1 < argc) start_symbol = argv[++i];
+        else if (arg == "--online") online = true;
+        else if (arg == "--edit") edit = true;
+        else if (arg == "--cnf") cnf = true;
+        else if (arg == "--engine" && i + 1 < argc) engine = argv[++i];
+        else if (arg == "--trees" && i + 1 < argc) trees = std::stoi(argv[++i]);
+        else if (arg == "--beam" && i + 1 < argc) beam = std::stoi(argv[++i]);
+        else if (arg == "--threshold" && i + 1 < argc) threshold = std::stod(argv[++i]);
+        else if (arg == "--batch") {
+            batch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') batch_file = argv[++i];
+            else if (i + 1 < argc && std::string(argv[i + 1]) == "-") i++;
+        } else if (arg == "--tokens") {
+            tokens = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') token_file = argv[++i];
+            else if (i + 1 < argc && std::string(argv[i + 1]) == "-") i++;
         }
-        grammar[non_terminal].push_back(production);
     }
 
-    file.close();
-    return grammar;
-}
+    if (threads < 0) threads = batch ? 0 : 1;
+    if (trees < 0) trees = engine == "earley" ? 0 : 1;
 
-/**
- * @brief CYK algorithm to check if a given string can be derived from a given CFG
- * Procedure
- * 1. Initialize a table of size n x n where n is the length of the input string
- * 2. Fill the table with the non-terminals that can derive the terminal symbols in the input string
- * 3. For each length of the substring, iterate over the table and check if the non-terminals can derive the substring
- * 4. If the start symbol is present in the table[0][n-1], then the input string can be derived from the grammar
- * 
- * @param input 
- * @param grammar 
- * @param start_symbol 
- * @return std::vector<std::vector<std::unordered_set<std::string>>> 
- */
+    std::unordered_map<std::string, std::vector<std::vector<std::string>>> grammar = readCFG(filename);
+    if (cnf) {
+        CNFResult converted = toCNF(grammar, start_symbol, !tokens);
+        std::cerr << "CNF: " << converted.before << " -> " << converted.after << std::endl;
+        grammar = converted.grammar;
+        start_symbol = converted.start_symbol;
+    }
+    CompiledGrammar compiled(grammar, start_symbol);
+    if (compiled.report().changed()) compiled.report().print(std::cerr);
 
-std::vector<std::vector<std::unordered_set<std::string>>> cyk(const std::string& input, 
-    const std::unordered_map<std::string, std::vector<std::vector<std::string>>>& grammar, const std::string& start_symbol) {
-    
-    int n = input.size();
-    std::vector<std::vector<std::unordered_set<std::string>>> table(n, std::vector<std::unordered_set<std::string>>(n));
-    for (int i = 0; i < n; ++i) { //Fill the diagonal of the table with the non-terminals that can derive the terminal symbols
-        std::string terminal(1, input[i]);
-        for (const auto entry : grammar) { 
-            const std::string non_terminal = entry.first;
-            const std::vector<std::vector<std::string>>productions = entry.second;
-            for(const auto prod : productions) {
-                if (prod.size() == 1 && prod[0] == terminal) {
-                    table[i][i].insert(non_terminal);
-                }
+    if (batch) {
+        // no visualization, the grammar is compiled once for every line
+        std::ios::sync_with_stdio(false);
+        if (batch_file == "-") {
+            batchRecognize(std::cin, std::cout, compiled, threads);
+        } else {
+            std::ifstream file(batch_file);
+            if (!file.is_open()) {
+                std::cerr << "Error opening file: " << batch_file << std::endl;
+                return 1;
             }
+            batchRecognize(file, std::cout, compiled, threads);
         }
+        return 0;
     }
 
-
-    //Fill the table with the non-terminals that can derive the terminal symbols in the input string
-    //For each length of the substring, iterate over the table and check if the non-terminals can derive the substring
-
-    for (int len = 2; len <= n; len++) {
-        for (int i = 0; i <= n - len; i++) { 
-            for (int k = i; k < i + len - 1; k++) {
-                for (const auto [non_terminal,productions] : grammar) { //For each non-terminal in the grammar
-                    for(const auto prod : productions) {
-                        if (prod.size() == 2) { //If the production is of the form A -> BC
-                            if (table[i][k].count(prod[0]) && table[k + 1][i+ len -1].count(prod[1])) {
-                                table[i][i + len -1].insert(non_terminal); //If the non-terminal can derive the substring, add it to the table
-                            }
-                        }
-                    }
-                }
-            }
+    if (tokens) {
+        // a token file is memory mapped, the tokens are views into it until they are interned
+        std::string line;
+        std::unique_ptr<MappedFile> mapped;
+        std::string_view text;
+        if (token_file == "-") {
+            std::getline(std::cin, line);
+            text = line;
+        } else {
+            mapped = std::make_unique<MappedFile>(token_file);
+            text = mapped->text();
         }
+        std::vector<int> ids = tokenIds(text, compiled);
+        bool derived = bitCYKAccepts(bitCYK(ids, compiled), compiled);
+        std::cout << ids.size() << " tokens" << (derived ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        int unknown = unknownToken(ids);
+        if (unknown >= 0) std::cout << "Token " << unknown << " is not a terminal of the grammar." << std::endl;
+        return 0;
     }
 
-    return table;
-}
-
-void visualizeCYKTable(const std::vector<std::vector<std::unordered_set<std::string>>>& table, const std::string& input, const std::string& filename) {
-    std::ofstream file(filename + ".dot");
-    file << "digraph CYK {\n";
-    file << "rankdir=TB;\n";
-    file << "node [shape=plaintext];\n";
-    file << "CYKTable [label=<\n";
-    file << "<TABLE BORDER=\"0\" CELLBORDER=\"1\" CELLSPACING=\"0\">\n";
-
-    int n = input.size();
-    file << "<TR><TD></TD>"; 
-    for (int i = 0; i < n; ++i) {
-        file << "<TD>" << input[i] << "</TD>";
+    if (online) {
+        // one line per symbol : prefix length and whether that prefix is in the language
+        OnlineCYK recognizer(compiled);
+        char symbol;
+        while (std::cin >> symbol) {
+            bool prefix = recognizer.push(symbol);
+            std::cout << recognizer.table().size() << (prefix ? " accept" : " reject") << "\n";
+        }
+        return 0;
     }
-    file << "</TR>\n";
 
-    for (int i = 0; i < n; ++i) {
-        file << "<TR><TD>" << i + 1 << "</TD>\n"; 
-        for (int j = 0; j < n; ++j) { 
-            file << "<TD>";
-            if (j <= i) {
-                for (int x = 0; x < table[j][i].size(); x++) {
-                    file << *std::next(table[j][i].begin(), x) ;
-                    if (x < table[j][i].size() - 1) {
-                        file << ",";
-                    }
-                }
-            }
-            file << "</TD>";
+    if (edit) {
+        // first line is the input, then "r p c" replaces, "i p c" inserts and "d p" deletes at position p
+        IncrementalCYK recognizer(compiled);
+        std::string line;
+        std::getline(std::cin, line);
+        recognizer.assign(line);
+        std::cout << (recognizer.accepts() ? "accept" : "reject") << " " << recognizer.lastRecomputed() << " cells" << std::endl;
+        while (std::getline(std::cin, line)) {
+            std::istringstream command(line);
+            char op, symbol = 0;
+            int p;
+            if (!(command >> op >> p)) continue;
+            command >> symbol;
+            if (op == 'r') recognizer.replace(p, symbol);
+            else if (op == 'i') recognizer.insert(p, symbol);
+            else if (op == 'd') recognizer.erase(p);
+            else continue;
+            std::cout << (recognizer.accepts() ? "accept " : "reject ") << recognizer.input() << " : "
+                      << recognizer.lastRecomputed() << " of " << recognizer.fullRebuildCells() << " cells recomputed" << std::endl;
         }
-        file << "</TR>\n";
+        return 0;
     }
 
-    file << "</TABLE>\n";
-    file << ">];\n";
-    file << "}\n";
-    file.close();
-    std::string command = "dot -Tpng " + filename + ".dot -o " + filename + ".png";
-    system(command.c_str());
-}
-
-int main() {
-    std::string filename = "cfg.txt"; 
     std::string input;
     std::cout << "Enter the input string: ";
     std::cin >> input;
 
+    if (engine == "earley") {
+        EarleyParser parser(grammar, start_symbol);
+        bool derived = parser.recognize(input);
+        std::cout << "Input \"" << input << "\"" << (derived ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        std::cout << "Earley items: " << parser.itemCount() << std::endl;
+        // the tree is read from a chart rebuilt without Leo items, quadratic on right recursion,
+        // so it is only built when asked for with --trees, one tree whatever k is
+        std::optional<ParseTree> tree;
+        if (derived && trees > 0) tree = parser.parse(input);
+        if (tree) {
+            std::cout << tree->toString() << std::endl;
+            exportParseTreeDot(*tree, "parse_tree");
+            std::string command = "rm -f parse_tree.dot";
+            system(command.c_str());
+        }
+        return 0;
+    }
+    if (engine == "ll1") {
+        LL1Parser parser(grammar, start_symbol);
+        writeCFG(parser.grammar(), start_symbol, std::cout);
+        parser.printFirstFollow(std::cout);
+        if (!parser.isLL1()) {
+            parser.printConflicts(std::cout);
+            std::cout << "The grammar is not LL(1), falling back to CYK on its CNF." << std::endl;
+            bool derived = parser.recognize(input);
+            std::cout << "Input \"" << input << "\"" << (derived ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+            return 0;
+        }
+        std::optional<ParseTree> tree = parser.parse(input);
+        std::cout << "Input \"" << input << "\"" << (tree ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        if (tree) {
+            std::cout << tree->toString() << std::endl;
+            exportParseTreeDot(*tree, "parse_tree");
+            std::string command = "rm -f parse_tree.dot";
+            system(command.c_str());
+        } else {
+            std::cout << "Syntax error at position " << parser.errorPosition() << std::endl;
+        }
+        return 0;
+    }
+    if (engine == "pda") {
+        PDA pda = cfgToPDA(grammar, start_symbol);
+        pda.print(std::cout);
+        std::cout << "PDA: " << pda.numStates() << " states, " << pda.numStackSymbols() << " stack symbols, "
+                  << pda.numTransitions() << " transitions" << std::endl;
+        GSSSimulator simulator(pda);
+        bool final_state = simulator.accepts(input, PDA::Acceptance::FINAL_STATE);
+        bool empty_stack = simulator.accepts(input, PDA::Acceptance::EMPTY_STACK);
+        std::cout << "Input \"" << input << "\"" << (final_state ? " is" : " is not") << " accepted by final state and"
+                  << (empty_stack ? " is" : " is not") << " accepted by empty stack." << std::endl;
+        const GSSSimulator::Stats& stats = simulator.stats();
+        std::cout << "GSS: " << stats.nodes << " nodes, " << stats.edges << " edges, " << stats.descriptors << " configurations, at most "
+                  << stats.peak_live_nodes << " live nodes and " << stats.peak_live_edges << " live edges" << std::endl;
+        return 0;
+    }
+    if (engine == "viterbi") {
+        // weights are read again, the CNF conversion does not carry them
+        if (cnf) {
+            std::cerr << "--engine viterbi needs a weighted grammar already in CNF" << std::endl;
+            return 1;
+        }
+        ViterbiCYK parser(readWeightedCFG(filename), start_symbol);
+        std::optional<double> score = parser.parse(input, beam, threshold);
+        std::cout << "Input \"" << input << "\"" << (score ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        std::cout << "Chart: " << parser.entries() << " entries, " << parser.rulesApplied() << " rule applications" << std::endl;
+        if (score) {
+            std::cout << "Best parse, log probability " << *score << std::endl;
+            ParseTree tree = *parser.bestTree();
+            std::cout << tree.toString() << std::endl;
+            exportParseTreeDot(tree, "parse_tree");
+            std::string command = "rm -f parse_tree.dot";
+            system(command.c_str());
+        }
+        return 0;
+    }
+    if (engine == "valiant") {
+        bool derived = ValiantCYK(compiled).recognize(input);
+        std::cout << "Input \"" << input << "\"" << (derived ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        return 0;
+    }
+    if (engine == "classic") {
+        std::vector<std::vector<std::unordered_set<std::string>>> table = cyk(input, optimizeGrammar(grammar, start_symbol).grammar, start_symbol);
+        bool derived = !input.empty() && table[0][input.size() - 1].count(start_symbol);
+        std::cout << "Input \"" << input << "\"" << (derived ? " can" : " cannot") << " be derived from the grammar." << std::endl;
+        visualizeCYKTable(table, input, "cyk_table");
+        std::string command = "rm -f cyk_table.dot";
+        system(command.c_str());
+        return 0;
+    }
+    if (engine != "cyk") {
+        std::cerr << "Unknown engine: " << engine << std::endl;
+        return 1;
+    }
 
-    std::unordered_map<std::string, std::vector<std::vector<std::string>>> grammar = readCFG(filename);
-    std::string start_symbol = "S"; 
-    std::vector<std::vector<std::unordered_set<std::string>>> table = cyk(input, grammar, start_symbol);
-    bool isParse = table[0][input.size() - 1].count(start_symbol) > 0;
+    BitCYKTable bit_table = threads == 1 ? bitCYK(input, compiled) : parallelBitCYK(input, compiled, threads);
+    bool isParse = bitCYKAccepts(bit_table, compiled);
+    std::vector<std::vector<std::unordered_set<std::string>>> table = bit_table.toSets(compiled);
 
     if(isParse) {
         std::cout << "Input \"" << input << "\" can be derived from the grammar." << std::endl;
@@ -147,7 +239,19 @@ int main() {
     }
     visualizeCYKTable(table, input, "cyk_table");
 
-    std::string command = "rm -f cyk_table.dot";
+    if (isParse) {
+        SPPF forest(bit_table, compiled, input);
+        std::cout << "Parse forest: " << forest.symbolNodes().size() << " symbol nodes, "
+                  << forest.packedNodes().size() << " packed nodes" << std::endl;
+        std::cout << "Number of derivations: " << forest.countDerivations<BigCount>()[forest.root()].toString() << std::endl;
+        std::vector<ParseTree> first = forest.firstTrees(trees);
+        for (const auto& tree : first) {
+            std::cout << tree.toString() << std::endl;
+        }
+        if (!first.empty()) exportParseTreeDot(first[0], "parse_tree");
+    }
+
+    std::string command = "rm -f cyk_table.dot parse_tree.dot";
     system(command.c_str());
 
     return 0;
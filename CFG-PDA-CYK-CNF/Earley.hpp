@@ -0,0 +1,313 @@
+#pragma once
+#include "CNF.hpp"
+#include "sppf.hpp"
+
+/**
+ * @brief Earley recognizer and parser for any CFG read by readCFG, no CNF needed
+ * An item is a dotted rule with the position where it started, set i holds the items
+ * reached after reading input[0..i-1]. Procedure for every set, in order
+ * 1. predict : the dot is before a nonterminal B, add B -> . gamma at i. When B is
+ *    nullable the item also moves past B right away (Aycock and Horspool), so empty
+ *    completions never have to be chased inside a set
+ * 2. scan    : the dot is before the terminal input[i], the advanced item goes to set i + 1
+ * 3. complete: B -> gamma . started at j, every item of set j waiting on B advances.
+ *    When set j has exactly one item waiting on B and B is its last symbol, the
+ *    completion is deterministic, Leo's items jump straight to the topmost item of such
+ *    a chain, so right recursion costs O(1) per set instead of O(depth)
+ * Items of every set are indexed by the symbol after their dot, completion and
+ * scanning only look at the items that wait on the symbol at hand.
+ * Linear on LR(k) grammars with Leo items, quadratic on unambiguous and cubic at worst.
+ */
+
+class EarleyParser {
+public:
+    EarleyParser(const Grammar& grammar, const std::string& start_symbol) {
+        std::vector<std::string> order;
+        for (const auto& entry : grammar) order.push_back(entry.first);
+        std::sort(order.begin(), order.end());
+        for (const auto& non_terminal : order) {
+            symbolId(non_terminal, true);
+        }
+        std::fill(std::begin(terminal_of_char), std::end(terminal_of_char), -1);
+
+        int augmented = names.size();
+        names.push_back(start_symbol + "'");
+        is_non_terminal.push_back(true);
+        rules_of.emplace_back();
+        start = augmented;
+        addRule(augmented, {symbolId(start_symbol, true)}); // a start symbol without rules derives nothing
+
+        for (const auto& non_terminal : order) {
+            for (const auto& prod : grammar.at(non_terminal)) {
+                std::vector<int> rhs;
+                if (!isEpsilonProduction(prod)) {
+                    for (const auto& symbol : prod) {
+                        if (grammar.count(symbol)) {
+                            rhs.push_back(symbol_id[symbol]);
+                        } else {
+                            for (char c : symbol) rhs.push_back(terminalId(c)); // input is read one character at a time
+                        }
+                    }
+                }
+                addRule(symbol_id[non_terminal], rhs);
+            }
+        }
+
+        nullable.assign(names.size(), false);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int r = 0; r < rules.size(); r++) {
+                if (nullable[rules[r].lhs]) continue;
+                bool all = true;
+                for (int symbol : rules[r].rhs) all = all && nullable[symbol];
+                if (all) nullable[rules[r].lhs] = changed = true;
+            }
+        }
+        predicted_at.assign(names.size(), -1);
+    }
+
+    /**
+     * @brief Earley recognition
+     *
+     * @param input
+     * @param leo use Leo items for deterministic completion chains
+     * @return true if the start symbol derives the input
+     */
+
+    bool recognize(const std::string& input, bool leo = true) {
+        int n = input.size();
+        sets.assign(n + 1, EarleySet());
+        std::fill(predicted_at.begin(), predicted_at.end(), -1);
+        for (int r : rules_of[start]) add(0, {first_dotted[r], 0});
+
+        for (int i = 0; i <= n; i++) {
+            int scanned = i < n ? terminal_of_char[(unsigned char)input[i]] : -1;
+            for (int index = 0; index < sets[i].items.size(); index++) {
+                Item item = sets[i].items[index];
+                int symbol = next_symbol[item.dotted];
+                if (symbol < 0) {
+                    complete(item, i, leo);
+                } else if (is_non_terminal[symbol]) {
+                    if (predicted_at[symbol] != i) {
+                        predicted_at[symbol] = i;
+                        for (int r : rules_of[symbol]) add(i, {first_dotted[r], i});
+                    }
+                    if (nullable[symbol]) add(i, {item.dotted + 1, item.origin});
+                } else if (symbol == scanned) {
+                    add(i + 1, {item.dotted + 1, item.origin});
+                }
+            }
+            if (i < n && sets[i + 1].items.empty()) {
+                sets.resize(i + 2); // no item survives, the rest of the input cannot be read
+                return false;
+            }
+        }
+        return sets[n].seen.count(key({first_dotted[rules_of[start][0]] + 1, 0})) > 0;
+    }
+
+    /**
+     * @brief One parse tree of the input, read back from a chart built without Leo items
+     * For a completed item A -> X1 .. Xk over [a, b] the symbols are matched right to left,
+     * Xk over [c, b] is kept when A -> X1 .. Xk-1 . Xk started at a is in set c and Xk
+     * derives input[c..b-1], i.e. some Xk rule started at c is complete in set b
+     *
+     * @param input
+     * @return std::optional<ParseTree> empty if the input is not in the language
+     */
+
+    std::optional<ParseTree> parse(const std::string& input) {
+        text = input;
+        if (!recognize(input, false)) return std::nullopt;
+        in_progress.clear();
+        return buildNode(rules[rules_of[start][0]].rhs[0], 0, input.size());
+    }
+
+    // items in the chart of the last input
+    size_t itemCount() const {
+        size_t count = 0;
+        for (const auto& set : sets) count += set.items.size();
+        return count;
+    }
+
+private:
+    struct Rule {
+        int lhs;
+        std::vector<int> rhs;
+    };
+
+    struct Item {
+        int dotted; // dotted rule id : first_dotted[rule] + position of the dot
+        int origin;
+    };
+
+    struct EarleySet {
+        std::vector<Item> items;
+        std::unordered_set<uint64_t> seen;
+        std::unordered_map<int, std::vector<int>> waiting; // symbol after the dot -> items
+        std::unordered_map<int, Item> leo; // dotted == -1 : no deterministic chain for the symbol
+    };
+
+    std::vector<std::string> names;
+    std::vector<bool> is_non_terminal;
+    std::unordered_map<std::string, int> symbol_id;
+    int terminal_of_char[256];
+    std::vector<Rule> rules;
+    std::vector<std::vector<int>> rules_of;
+    std::vector<int> first_dotted;
+    std::vector<int> next_symbol; // -1 when the dot is at the end
+    std::vector<int> rule_of_dotted;
+    std::vector<bool> nullable;
+    std::vector<int> predicted_at;
+    int start;
+
+    std::vector<EarleySet> sets;
+    std::string text;
+    std::set<std::tuple<int, int, int>> in_progress;
+
+    int symbolId(const std::string& name, bool non_terminal) {
+        auto it = symbol_id.find(name);
+        if (it != symbol_id.end()) return it->second;
+        int id = names.size();
+        symbol_id[name] = id;
+        names.push_back(name);
+        is_non_terminal.push_back(non_terminal);
+        rules_of.emplace_back();
+        return id;
+    }
+
+    int terminalId(char c) {
+        int& id = terminal_of_char[(unsigned char)c];
+        if (id < 0) {
+            id = names.size();
+            names.push_back(std::string(1, c));
+            is_non_terminal.push_back(false);
+            rules_of.emplace_back();
+        }
+        return id;
+    }
+
+    void addRule(int lhs, const std::vector<int>& rhs) {
+        int r = rules.size();
+        rules.push_back({lhs, rhs});
+        rules_of[lhs].push_back(r);
+        first_dotted.push_back(next_symbol.size());
+        for (int dot = 0; dot <= rhs.size(); dot++) {
+            next_symbol.push_back(dot < rhs.size() ? rhs[dot] : -1);
+            rule_of_dotted.push_back(r);
+        }
+    }
+
+    static uint64_t key(const Item& item) {
+        return (uint64_t)item.dotted << 32 | (uint32_t)item.origin;
+    }
+
+    void add(int i, const Item& item) {
+        EarleySet& set = sets[i];
+        if (!set.seen.insert(key(item)).second) return;
+        int symbol = next_symbol[item.dotted];
+        if (symbol >= 0) set.waiting[symbol].push_back(set.items.size());
+        set.items.push_back(item);
+    }
+
+    void complete(const Item& item, int i, bool leo) {
+        int j = item.origin;
+        if (j == i) return; // empty completions were taken care of at prediction time
+        int symbol = rules[rule_of_dotted[item.dotted]].lhs;
+        if (leo) {
+            Item top = leoItem(j, symbol);
+            if (top.dotted >= 0) {
+                add(i, top);
+                return;
+            }
+        }
+        auto it = sets[j].waiting.find(symbol);
+        if (it == sets[j].waiting.end()) return;
+        for (int index : it->second) {
+            const Item& waiting = sets[j].items[index];
+            add(i, {waiting.dotted + 1, waiting.origin});
+        }
+    }
+
+    /**
+     * @brief Topmost item of the deterministic completion chain of symbol in set j
+     * The chain continues while the only item waiting on the symbol ends with it,
+     * then moves to the origin of that item with its left side. Every set on the chain
+     * is already final, so the result is memoized per (set, symbol).
+     */
+
+    Item leoItem(int j, int symbol) {
+        std::vector<std::pair<int, int>> chain;
+        Item top{-1, 0}, candidate{-1, 0};
+        while (true) {
+            EarleySet& set = sets[j];
+            auto memo = set.leo.find(symbol);
+            if (memo != set.leo.end()) {
+                top = memo->second;
+                break;
+            }
+            auto waiting = set.waiting.find(symbol);
+            if (waiting == set.waiting.end() || waiting->second.size() != 1) {
+                set.leo[symbol] = {-1, 0};
+                break;
+            }
+            const Item& item = set.items[waiting->second[0]];
+            if (next_symbol[item.dotted + 1] >= 0) {
+                set.leo[symbol] = {-1, 0};
+                break;
+            }
+            candidate = {item.dotted + 1, item.origin};
+            chain.push_back({j, symbol});
+            if (item.origin == j) break;
+            symbol = rules[rule_of_dotted[item.dotted]].lhs;
+            j = item.origin;
+        }
+        if (chain.empty()) return top;
+        if (top.dotted < 0) top = candidate; // the chain ends here, its last step is the topmost item
+        for (auto [set, chain_symbol] : chain) sets[set].leo[chain_symbol] = top;
+        return top;
+    }
+
+    bool hasItem(int i, int dotted, int origin) const {
+        return sets[i].seen.count(key({dotted, origin})) > 0;
+    }
+
+    std::optional<ParseTree> buildNode(int symbol, int a, int b) {
+        if (!is_non_terminal[symbol]) {
+            if (b == a + 1 && terminal_of_char[(unsigned char)text[a]] == symbol) return ParseTree{names[symbol], {}};
+            return std::nullopt;
+        }
+        if (!in_progress.insert({symbol, a, b}).second) return std::nullopt; // a cycle through empty or unit rules
+        std::optional<ParseTree> result;
+        for (int r : rules_of[symbol]) {
+            if (!hasItem(b, first_dotted[r] + rules[r].rhs.size(), a)) continue;
+            ParseTree tree{names[symbol], {}};
+            if (buildRule(r, rules[r].rhs.size(), a, b, tree.children)) {
+                if (tree.children.empty()) tree.children.push_back({"ε", {}});
+                result = tree;
+                break;
+            }
+        }
+        in_progress.erase({symbol, a, b});
+        return result;
+    }
+
+    // children for rhs[0..dot-1] of rule r over input[a..b-1]
+    bool buildRule(int r, int dot, int a, int b, std::vector<ParseTree>& children) {
+        if (dot == 0) return a == b;
+        int symbol = rules[r].rhs[dot - 1];
+        int dotted = first_dotted[r] + dot - 1;
+        for (int c = b; c >= a; c--) {
+            if (!hasItem(c, dotted, a)) continue;
+            if (!is_non_terminal[symbol] && c != b - 1) continue;
+            auto subtree = buildNode(symbol, c, b);
+            if (!subtree) continue;
+            size_t size = children.size();
+            if (buildRule(r, dot - 1, a, c, children)) {
+                children.push_back(*subtree);
+                return true;
+            }
+            children.resize(size);
+        }
+        return false;
+    }
+};
@@ -0,0 +1,468 @@
+#pragma once
+#include "CNF.hpp"
+#include "sppf.hpp"
+
+// a copy of the grammar where every multi character terminal is spelled out, input is read one character at a time
+Grammar spellTerminals(const Grammar& grammar) {
+    Grammar spelled;
+    for (const auto& [non_terminal, productions] : grammar) {
+        auto& target = spelled[non_terminal];
+        for (const auto& prod : productions) {
+            std::vector<std::string> rhs;
+            if (!isEpsilonProduction(prod)) {
+                for (const auto& symbol : prod) {
+                    if (grammar.count(symbol)) rhs.push_back(symbol);
+                    else for (char c : symbol) rhs.push_back(std::string(1, c));
+                }
+            }
+            target.push_back(rhs);
+        }
+    }
+    return spelled;
+}
+
+// name + "'" until the name is free
+std::string freshNonTerminal(const Grammar& grammar, std::string name) {
+    do {
+        name += "'";
+    } while (grammar.count(name));
+    return name;
+}
+
+/**
+ * @brief Remove left recursion, direct and indirect
+ * Procedure (nonterminals ordered A1 .. Am, the start symbol first)
+ * 1. for every i and every j < i, Ai -> Aj gamma is replaced by Ai -> delta gamma
+ *    for every rule Aj -> delta, afterwards no Ai starts with an earlier Aj
+ * 2. direct recursion Ai -> Ai alpha | beta becomes
+ *    Ai -> beta Ai',  Ai' -> alpha Ai' | ε
+ * Left recursion hidden behind a nullable first symbol can survive, the LL(1)
+ * table then reports it as a conflict.
+ *
+ * @param grammar
+ * @param start_symbol
+ * @return Grammar an empty right side stands for ε
+ */
+
+Grammar eliminateLeftRecursion(const Grammar& grammar, const std::string& start_symbol) {
+    Grammar result = spellTerminals(grammar);
+    std::vector<std::string> order;
+    for (const auto& entry : result) {
+        if (entry.first != start_symbol) order.push_back(entry.first);
+    }
+    std::sort(order.begin(), order.end());
+    if (result.count(start_symbol)) order.insert(order.begin(), start_symbol);
+
+    for (int i = 0; i < order.size(); i++) {
+        auto& productions = result[order[i]];
+        for (int j = 0; j < i; j++) {
+            std::vector<std::vector<std::string>> replaced;
+            for (const auto& prod : productions) {
+                if (!prod.empty() && prod[0] == order[j]) {
+                    for (const auto& delta : result[order[j]]) {
+                        std::vector<std::string> rhs = delta;
+                        rhs.insert(rhs.end(), prod.begin() + 1, prod.end());
+                        replaced.push_back(rhs);
+                    }
+                } else {
+                    replaced.push_back(prod);
+                }
+            }
+            productions = replaced;
+        }
+
+        std::vector<std::vector<std::string>> recursive, other;
+        for (const auto& prod : productions) {
+            if (!prod.empty() && prod[0] == order[i]) {
+                if (prod.size() > 1) recursive.push_back({prod.begin() + 1, prod.end()}); // A -> A derives nothing new
+            } else {
+                other.push_back(prod);
+            }
+        }
+        if (recursive.empty()) {
+            productions = other;
+            continue;
+        }
+
+        std::string tail = freshNonTerminal(result, order[i]);
+        std::vector<std::vector<std::string>> head_rules, tail_rules;
+        for (auto prod : other) {
+            prod.push_back(tail);
+            head_rules.push_back(prod);
+        }
+        for (auto prod : recursive) {
+            prod.push_back(tail);
+            tail_rules.push_back(prod);
+        }
+        tail_rules.push_back({});
+        result[order[i]] = head_rules;
+        result[tail] = tail_rules;
+    }
+    return result;
+}
+
+/**
+ * @brief Left factoring, A -> alpha beta1 | alpha beta2 becomes A -> alpha A', A' -> beta1 | beta2
+ * alpha is the longest prefix shared by all rules of A that start with the same symbol,
+ * repeated until no two rules of a nonterminal start with the same symbol
+ *
+ * @param grammar
+ * @return Grammar an empty right side stands for ε
+ */
+
+Grammar leftFactor(const Grammar& grammar) {
+    Grammar result = spellTerminals(grammar);
+    std::vector<std::string> pending;
+    for (const auto& entry : result) pending.push_back(entry.first);
+    std::sort(pending.begin(), pending.end(), std::greater<std::string>());
+
+    while (!pending.empty()) {
+        std::string non_terminal = pending.back();
+        pending.pop_back();
+        auto& productions = result[non_terminal];
+
+        std::map<std::string, std::vector<int>> by_first;
+        for (int p = 0; p < productions.size(); p++) {
+            if (!productions[p].empty()) by_first[productions[p][0]].push_back(p);
+        }
+        for (const auto& [first, group] : by_first) {
+            if (group.size() < 2) continue;
+            size_t prefix = productions[group[0]].size();
+            for (int p : group) {
+                size_t common = 0;
+                while (common < prefix && common < productions[p].size() && productions[p][common] == productions[group[0]][common]) common++;
+                prefix = common;
+            }
+
+            std::string tail = freshNonTerminal(result, non_terminal);
+            std::vector<std::vector<std::string>> tail_rules, kept;
+            std::set<int> factored(group.begin(), group.end());
+            for (int p = 0; p < productions.size(); p++) {
+                if (factored.count(p)) tail_rules.push_back({productions[p].begin() + prefix, productions[p].end()});
+                else kept.push_back(productions[p]);
+            }
+            std::vector<std::string> head(productions[group[0]].begin(), productions[group[0]].begin() + prefix);
+            head.push_back(tail);
+            kept.push_back(head);
+
+            result[tail] = tail_rules;
+            result[non_terminal] = kept;
+            pending.push_back(tail);
+            pending.push_back(non_terminal); // other groups of this nonterminal, rules moved
+            break;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief LL(1) parser generator and table driven predictive parser
+ * Procedure
+ * 1. left recursion is eliminated and the grammar left factored (optional)
+ * 2. symbols are interned, FIRST and FOLLOW are bitsets over the terminals plus
+ *    the end marker $, both computed as fixpoints :
+ *    FIRST(A)  |= FIRST(X1 .. Xk) for every rule A -> X1 .. Xk
+ *    FOLLOW(Xi) |= FIRST(Xi+1 .. Xk), and FOLLOW(A) when Xi+1 .. Xk is nullable
+ * 3. table[A][a] gets A -> alpha for every a in FIRST(alpha), and for every a in
+ *    FOLLOW(A) when alpha is nullable, a cell with two rules is a conflict
+ * 4. parsing keeps an explicit stack of symbols, one table lookup per step
+ * When conflicts remain, the grammar is not LL(1) and recognition falls back to
+ * bitset CYK on the CNF of the original grammar.
+ */
+
+class LL1Parser {
+public:
+    struct Conflict {
+        std::string non_terminal;
+        std::string terminal;
+        std::vector<int> rules;
+    };
+
+    LL1Parser(const Grammar& grammar, const std::string& start_symbol, bool transform = true) : original(grammar), start_symbol(start_symbol) {
+        transformed = transform ? leftFactor(eliminateLeftRecursion(grammar, start_symbol)) : spellTerminals(grammar);
+
+        std::vector<std::string> order;
+        for (const auto& entry : transformed) {
+            if (entry.first != start_symbol) order.push_back(entry.first);
+        }
+        std::sort(order.begin(), order.end());
+        order.insert(order.begin(), start_symbol);
+        for (const auto& non_terminal : order) {
+            non_terminal_id[non_terminal] = non_terminal_names.size();
+            non_terminal_names.push_back(non_terminal);
+        }
+        std::set<std::string> terminals;
+        for (const auto& [non_terminal, productions] : transformed) {
+            for (const auto& prod : productions) {
+                for (const auto& symbol : prod) {
+                    if (!transformed.count(symbol)) terminals.insert(symbol);
+                }
+            }
+        }
+        std::fill(std::begin(terminal_of_char), std::end(terminal_of_char), -1);
+        for (const auto& terminal : terminals) {
+            terminal_of_char[(unsigned char)terminal[0]] = terminal_names.size();
+            terminal_names.push_back(terminal);
+        }
+        end_marker = terminal_names.size();
+        terminal_names.push_back("$");
+        words = (terminal_names.size() + 63) / 64;
+
+        int non_terminals = non_terminal_names.size();
+        for (const auto& non_terminal : order) {
+            if (!transformed.count(non_terminal)) continue;
+            for (const auto& prod : transformed.at(non_terminal)) {
+                std::vector<int> rhs;
+                for (const auto& symbol : prod) {
+                    rhs.push_back(transformed.count(symbol) ? non_terminal_id[symbol] : non_terminals + terminal_of_char[(unsigned char)symbol[0]]);
+                }
+                rules.push_back({non_terminal_id[non_terminal], rhs});
+            }
+        }
+
+        computeFirst();
+        computeFollow();
+        buildTable();
+    }
+
+    bool isLL1() const {
+        return conflict_list.empty();
+    }
+
+    const std::vector<Conflict>& conflicts() const {
+        return conflict_list;
+    }
+
+    // the grammar the table was built from
+    const Grammar& grammar() const {
+        return transformed;
+    }
+
+    std::set<std::string> first(const std::string& non_terminal) const {
+        return terminalSet(first_sets[non_terminal_id.at(non_terminal)]);
+    }
+
+    std::set<std::string> follow(const std::string& non_terminal) const {
+        return terminalSet(follow_sets[non_terminal_id.at(non_terminal)]);
+    }
+
+    bool nullable(const std::string& non_terminal) const {
+        return nullable_set[non_terminal_id.at(non_terminal)];
+    }
+
+    /**
+     * @brief Predictive parse with an explicit stack
+     * The top of the stack is a terminal : it must be the next input symbol.
+     * The top is a nonterminal A : table[A][next] picks the rule, its right side
+     * replaces A, rightmost symbol pushed first. Tree nodes get all their
+     * children at once, so pointers to them stay valid while the stack holds them.
+     *
+     * @param input
+     * @return std::optional<ParseTree> empty on a syntax error, see errorPosition()
+     */
+
+    std::optional<ParseTree> parse(const std::string& input) {
+        const int non_terminals = non_terminal_names.size();
+        ParseTree root{start_symbol, {}};
+        std::vector<std::pair<int, ParseTree*>> stack = {{0, &root}};
+        size_t position = 0;
+        error_position = -1;
+
+        while (!stack.empty()) {
+            auto [symbol, node] = stack.back();
+            int next = position < input.size() ? terminal_of_char[(unsigned char)input[position]] : end_marker;
+            if (next < 0) break;
+
+            if (symbol >= non_terminals) {
+                if (symbol - non_terminals != next) break;
+                stack.pop_back();
+                position++;
+                continue;
+            }
+            int rule = table[symbol * terminal_names.size() + next];
+            if (rule < 0) break;
+            stack.pop_back();
+            const auto& rhs = rules[rule].rhs;
+            if (rhs.empty()) node->children.push_back({"ε", {}});
+            for (int s : rhs) {
+                node->children.push_back({s < non_terminals ? non_terminal_names[s] : terminal_names[s - non_terminals], {}});
+            }
+            for (int k = rhs.size() - 1; k >= 0; k--) {
+                stack.push_back({rhs[k], &node->children[k]});
+            }
+        }
+
+        if (!stack.empty() || position != input.size()) {
+            error_position = position;
+            return std::nullopt;
+        }
+        return root;
+    }
+
+    /**
+     * @brief Membership, predictive when the grammar is LL(1), bitset CYK on its CNF otherwise
+     */
+
+    bool recognize(const std::string& input) {
+        if (isLL1()) return parse(input).has_value();
+        if (!fallback) {
+            fallback_cnf = toCNF(original, start_symbol);
+            fallback = std::make_unique<CompiledGrammar>(fallback_cnf.grammar, fallback_cnf.start_symbol);
+        }
+        if (input.empty()) return fallback_cnf.accepts_empty;
+        if (!fallback_cnf.grammar.count(fallback_cnf.start_symbol)) return false;
+        return bitCYKAccepts(bitCYK(input, *fallback), *fallback);
+    }
+
+    // position of the symbol where the last parse failed, -1 after a successful parse
+    int errorPosition() const {
+        return error_position;
+    }
+
+    void printFirstFollow(std::ostream& out) const {
+        for (const auto& non_terminal : non_terminal_names) {
+            if (!transformed.count(non_terminal)) continue;
+            out << non_terminal << (nullable(non_terminal) ? " (nullable)" : "") << "\n  FIRST  = {";
+            for (const auto& t : first(non_terminal)) out << " " << t;
+            out << " }\n  FOLLOW = {";
+            for (const auto& t : follow(non_terminal)) out << " " << t;
+            out << " }\n";
+        }
+    }
+
+    void printConflicts(std::ostream& out) const {
+        for (const auto& conflict : conflict_list) {
+            out << "conflict at [" << conflict.non_terminal << ", " << conflict.terminal << "] :";
+            for (int r : conflict.rules) out << " (" << ruleString(r) << ")";
+            out << "\n";
+        }
+    }
+
+    std::string ruleString(int r) const {
+        const int non_terminals = non_terminal_names.size();
+        std::string text = non_terminal_names[rules[r].lhs] + " ->";
+        if (rules[r].rhs.empty()) text += " ε";
+        for (int s : rules[r].rhs) text += " " + (s < non_terminals ? non_terminal_names[s] : terminal_names[s - non_terminals]);
+        return text;
+    }
+
+private:
+    struct Rule {
+        int lhs;
+        std::vector<int> rhs; // nonterminal ids, then terminal ids offset by the number of nonterminals
+    };
+
+    Grammar original;
+    Grammar transformed;
+    std::string start_symbol;
+    std::vector<std::string> non_terminal_names;
+    std::unordered_map<std::string, int> non_terminal_id;
+    std::vector<std::string> terminal_names;
+    int terminal_of_char[256];
+    int end_marker;
+    int words;
+    std::vector<Rule> rules;
+    std::vector<std::vector<Word>> first_sets;
+    std::vector<std::vector<Word>> follow_sets;
+    std::vector<bool> nullable_set;
+    std::vector<int> table; // non terminal * terminals + terminal -> rule, -1 is an error
+    std::vector<Conflict> conflict_list;
+    int error_position = -1;
+    CNFResult fallback_cnf;
+    std::unique_ptr<CompiledGrammar> fallback;
+
+    static bool orInto(std::vector<Word>& into, const std::vector<Word>& from) {
+        bool changed = false;
+        for (int w = 0; w < into.size(); w++) {
+            Word merged = into[w] | from[w];
+            changed |= merged != into[w];
+            into[w] = merged;
+        }
+        return changed;
+    }
+
+    std::set<std::string> terminalSet(const std::vector<Word>& bits) const {
+        std::set<std::string> names;
+        for (int t = 0; t < terminal_names.size(); t++) {
+            if (testBit(bits.data(), t)) names.insert(terminal_names[t]);
+        }
+        return names;
+    }
+
+    /**
+     * @brief FIRST of rhs[from..] into out
+     * @return true if rhs[from..] is nullable
+     */
+
+    bool firstOfSequence(const std::vector<int>& rhs, int from, std::vector<Word>& out) const {
+        const int non_terminals = non_terminal_names.size();
+        for (int k = from; k < rhs.size(); k++) {
+            if (rhs[k] >= non_terminals) {
+                setBit(out.data(), rhs[k] - non_terminals);
+                return false;
+            }
+            orInto(out, first_sets[rhs[k]]);
+            if (!nullable_set[rhs[k]]) return false;
+        }
+        return true;
+    }
+
+    void computeFirst() {
+        first_sets.assign(non_terminal_names.size(), std::vector<Word>(words, 0));
+        nullable_set.assign(non_terminal_names.size(), false);
+        std::vector<Word> scratch(words);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& rule : rules) {
+                std::fill(scratch.begin(), scratch.end(), 0);
+                bool empty = firstOfSequence(rule.rhs, 0, scratch);
+                changed |= orInto(first_sets[rule.lhs], scratch);
+                if (empty && !nullable_set[rule.lhs]) nullable_set[rule.lhs] = changed = true;
+            }
+        }
+    }
+
+    void computeFollow() {
+        const int non_terminals = non_terminal_names.size();
+        follow_sets.assign(non_terminals, std::vector<Word>(words, 0));
+        setBit(follow_sets[0].data(), end_marker);
+        std::vector<Word> scratch(words);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto& rule : rules) {
+                for (int k = 0; k < rule.rhs.size(); k++) {
+                    int symbol = rule.rhs[k];
+                    if (symbol >= non_terminals) continue;
+                    std::fill(scratch.begin(), scratch.end(), 0);
+                    if (firstOfSequence(rule.rhs, k + 1, scratch)) orInto(scratch, follow_sets[rule.lhs]);
+                    changed |= orInto(follow_sets[symbol], scratch);
+                }
+            }
+        }
+    }
+
+    void buildTable() {
+        const int columns = terminal_names.size();
+        table.assign(non_terminal_names.size() * columns, -1);
+        std::map<std::pair<int, int>, std::vector<int>> clashes;
+        std::vector<Word> predict(words);
+        for (int r = 0; r < rules.size(); r++) {
+            std::fill(predict.begin(), predict.end(), 0);
+            if (firstOfSequence(rules[r].rhs, 0, predict)) orInto(predict, follow_sets[rules[r].lhs]);
+            for (int t = 0; t < columns; t++) {
+                if (!testBit(predict.data(), t)) continue;
+                int& cell = table[rules[r].lhs * columns + t];
+                if (cell < 0) {
+                    cell = r;
+                } else {
+                    auto& clash = clashes[{rules[r].lhs, t}];
+                    if (clash.empty()) clash.push_back(cell);
+                    clash.push_back(r);
+                }
+            }
+        }
+        for (const auto& [cell, clash] : clashes) {
+            conflict_list.push_back({non_terminal_names[cell.first], terminal_names[cell.second], clash});
+        }
+    }
+};
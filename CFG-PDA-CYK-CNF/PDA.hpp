@@ -0,0 +1,337 @@
+#pragma once
+#include "CNF.hpp"
+
+/**
+ * @brief Nondeterministic pushdown automaton in a normalized form
+ * Every transition does exactly one thing : read one input character, push one
+ * stack symbol, pop one stack symbol, or none of these (an ε move). Any PDA can be
+ * brought to this form with extra states, and it keeps the simulation simple.
+ */
+
+class PDA {
+public:
+    enum class Acceptance {FINAL_STATE, EMPTY_STACK};
+    static constexpr int NONE = -1; // no input symbol (ε), nothing popped or nothing pushed
+
+    struct Transition {
+        int to;
+        int symbol; // input character 0 .. 255 or NONE
+        int pop;
+        int push;
+    };
+
+    int addState(const std::string& name, bool final = false) {
+        state_names.push_back(name);
+        final_states.push_back(final);
+        transitions.emplace_back();
+        return state_names.size() - 1;
+    }
+
+    int addStackSymbol(const std::string& name) {
+        stack_symbol_names.push_back(name);
+        return stack_symbol_names.size() - 1;
+    }
+
+    void addTransition(int from, int to, int symbol, int pop, int push) {
+        if ((symbol != NONE) + (pop != NONE) + (push != NONE) > 1) {
+            throw std::runtime_error("PDA transitions read, push or pop at most one symbol");
+        }
+        transitions[from].push_back({to, symbol, pop, push});
+    }
+
+    void setStart(int state, int initial_stack_symbol) {
+        start_state = state;
+        initial_stack = initial_stack_symbol;
+    }
+
+    int startState() const {
+        return start_state;
+    }
+
+    int initialStackSymbol() const {
+        return initial_stack;
+    }
+
+    bool isFinal(int state) const {
+        return final_states[state];
+    }
+
+    const std::vector<Transition>& transitionsFrom(int state) const {
+        return transitions[state];
+    }
+
+    int numStates() const {
+        return state_names.size();
+    }
+
+    int numStackSymbols() const {
+        return stack_symbol_names.size();
+    }
+
+    size_t numTransitions() const {
+        size_t count = 0;
+        for (const auto& from : transitions) count += from.size();
+        return count;
+    }
+
+    const std::string& stateName(int state) const {
+        return state_names[state];
+    }
+
+    const std::string& stackSymbolName(int symbol) const {
+        return stack_symbol_names[symbol];
+    }
+
+    // one transition per line : from --input, pop/push--> to
+    void print(std::ostream& out) const {
+        for (int from = 0; from < numStates(); from++) {
+            for (const auto& t : transitions[from]) {
+                out << state_names[from] << " --";
+                out << (t.symbol == NONE ? "ε" : std::string(1, char(t.symbol))) << ", ";
+                out << (t.pop == NONE ? "ε" : stack_symbol_names[t.pop]) << "/";
+                out << (t.push == NONE ? "ε" : stack_symbol_names[t.push]);
+                out << "--> " << state_names[t.to] << (final_states[t.to] ? " (final)" : "") << "\n";
+            }
+        }
+    }
+
+private:
+    std::vector<std::string> state_names;
+    std::vector<bool> final_states;
+    std::vector<std::string> stack_symbol_names;
+    std::vector<std::vector<Transition>> transitions;
+    int start_state = 0;
+    int initial_stack = 0;
+};
+
+/**
+ * @brief PDA of a CFG whose states are the dotted rules of the grammar
+ * Procedure
+ * 1. item A -> alpha . a beta reads a and moves to A -> alpha a . beta
+ * 2. item A -> alpha . B beta pushes the return item A -> alpha B . beta and moves to call B
+ * 3. call B moves to B -> . gamma for every rule of B
+ * 4. item B -> gamma . moves to done B
+ * 5. done B pops a return item A -> alpha B . beta and moves to it
+ * The machine starts in call S with Z0 on the stack, done S pops Z0 and enters the
+ * final state, so it accepts by final state and by empty stack alike.
+ * Stack symbols are one per return item, the size is linear in the grammar.
+ *
+ * @param grammar as read by readCFG
+ * @param start_symbol
+ * @return PDA
+ */
+
+PDA cfgToPDA(const Grammar& grammar, const std::string& start_symbol) {
+    PDA pda;
+    std::vector<std::string> order;
+    for (const auto& entry : grammar) order.push_back(entry.first);
+    std::sort(order.begin(), order.end());
+    if (!grammar.count(start_symbol)) order.push_back(start_symbol); // no rules, the language is empty
+
+    std::unordered_map<std::string, int> call, done;
+    for (const auto& non_terminal : order) {
+        call[non_terminal] = pda.addState("call " + non_terminal);
+        done[non_terminal] = pda.addState("done " + non_terminal);
+    }
+    int accept = pda.addState("accept", true);
+    int bottom = pda.addStackSymbol("Z0");
+    pda.setStart(call[start_symbol], bottom);
+    pda.addTransition(done[start_symbol], accept, PDA::NONE, bottom, PDA::NONE);
+
+    for (const auto& non_terminal : order) {
+        if (!grammar.count(non_terminal)) continue;
+        for (const auto& prod : grammar.at(non_terminal)) {
+            std::vector<std::string> rhs;
+            if (!isEpsilonProduction(prod)) {
+                for (const auto& symbol : prod) {
+                    if (grammar.count(symbol)) rhs.push_back(symbol);
+                    else for (char c : symbol) rhs.push_back(std::string(1, c)); // input is read one character at a time
+                }
+            }
+
+            std::vector<int> items;
+            for (int dot = 0; dot <= rhs.size(); dot++) {
+                std::string name = "[" + non_terminal + " ->";
+                for (int k = 0; k < rhs.size(); k++) name += (k == dot ? " . " : " ") + rhs[k];
+                if (dot == rhs.size()) name += " .";
+                items.push_back(pda.addState(name + "]"));
+            }
+            pda.addTransition(call[non_terminal], items[0], PDA::NONE, PDA::NONE, PDA::NONE);
+            pda.addTransition(items.back(), done[non_terminal], PDA::NONE, PDA::NONE, PDA::NONE);
+
+            for (int dot = 0; dot < rhs.size(); dot++) {
+                const std::string& symbol = rhs[dot];
+                if (!grammar.count(symbol)) {
+                    pda.addTransition(items[dot], items[dot + 1], (unsigned char)symbol[0], PDA::NONE, PDA::NONE);
+                    continue;
+                }
+                int return_item = pda.addStackSymbol(pda.stateName(items[dot + 1]));
+                pda.addTransition(items[dot], call[symbol], PDA::NONE, PDA::NONE, return_item);
+                pda.addTransition(done[symbol], items[dot + 1], PDA::NONE, return_item, PDA::NONE);
+            }
+        }
+    }
+    return pda;
+}
+
+/**
+ * @brief Runs every computation of a PDA at once over a graph structured stack
+ * A GSS node is a stack symbol pushed at input position i while entering state q,
+ * keyed by (symbol, q, i), its edges lead to the nodes below it. Every stack
+ * that has the same top node shares it, so a configuration is a descriptor
+ * (state, top node) and there are polynomially many of them per position.
+ * Procedure for input position i
+ * 1. descriptors of position i are taken from a worklist, each one only once
+ * 2. ε move  : (q', node) at i.  read : (q', node) at i + 1 when the character matches
+ * 3. push Y  : node' = (Y, q', i) found or created, edge node' -> node, (q', node') at i
+ * 4. pop X   : when the top is X, (q', below) at i for every edge of the top node.
+ *    Nodes of position i can still get edges after they were popped, every pop
+ *    done on them is remembered and replayed for each later edge
+ * Only nodes of the current position ever get new edges, so lookups and
+ * pop records live per position.
+ */
+
+class GSSSimulator {
+public:
+    struct Stats {
+        size_t nodes = 0;
+        size_t edges = 0;
+        size_t descriptors = 0;
+        size_t peak_live_nodes = 0; // nodes reachable from the configurations after one position
+        size_t peak_live_edges = 0;
+    };
+
+    explicit GSSSimulator(const PDA& pda) : pda(pda) {}
+
+    bool accepts(const std::string& input, PDA::Acceptance mode = PDA::Acceptance::FINAL_STATE) {
+        nodes.clear();
+        statistics = Stats();
+        int n = input.size();
+
+        std::vector<std::pair<int, int>> current, next;
+        std::unordered_set<uint64_t> seen, next_seen;
+        int start_node = newNode(pda.initialStackSymbol(), 0);
+        current.push_back({pda.startState(), start_node});
+        seen.insert(key(pda.startState(), start_node));
+
+        for (int i = 0; i <= n; i++) {
+            node_index.clear();
+            edge_seen.clear();
+            int symbol = i < n ? (unsigned char)input[i] : -2;
+            auto add = [&](int state, int node) {
+                if (seen.insert(key(state, node)).second) current.push_back({state, node});
+            };
+
+            for (size_t d = 0; d < current.size(); d++) {
+                auto [state, node] = current[d];
+                for (const auto& t : pda.transitionsFrom(state)) {
+                    if (t.symbol != PDA::NONE) {
+                        if (t.symbol == symbol && next_seen.insert(key(t.to, node)).second) next.push_back({t.to, node});
+                    } else if (t.push != PDA::NONE) {
+                        int pushed = findNode(t.push, t.to, i);
+                        if (addEdge(pushed, node)) {
+                            for (int target : nodes[pushed].pops) add(target, node);
+                        }
+                        add(t.to, pushed);
+                    } else if (t.pop != PDA::NONE) {
+                        if (node == EMPTY || nodes[node].symbol != t.pop) continue;
+                        if (nodes[node].level == i) nodes[node].pops.push_back(t.to);
+                        for (int below : nodes[node].below) add(t.to, below);
+                    } else {
+                        add(t.to, node);
+                    }
+                }
+            }
+            statistics.descriptors += current.size();
+
+            if (i == n) break;
+            measureLive(next, i);
+            current.swap(next);
+            seen.swap(next_seen);
+            next.clear();
+            next_seen.clear();
+            if (current.empty()) return false;
+        }
+
+        for (auto [state, node] : current) {
+            if (mode == PDA::Acceptance::FINAL_STATE ? pda.isFinal(state) : node == EMPTY) return true;
+        }
+        return false;
+    }
+
+    const Stats& stats() const {
+        return statistics;
+    }
+
+private:
+    static constexpr int EMPTY = -1; // the stack below the initial symbol
+
+    struct Node {
+        int symbol;
+        int level;
+        std::vector<int> below; // EMPTY for the initial symbol
+        std::vector<int> pops;  // states entered by popping this node at its own level
+    };
+
+    const PDA& pda;
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, int> node_index; // (symbol, state) -> node of the current position
+    std::unordered_set<uint64_t> edge_seen;
+    std::vector<int> visited;
+    Stats statistics;
+
+    static uint64_t key(int a, int b) {
+        return (uint64_t)(uint32_t)a << 32 | (uint32_t)b;
+    }
+
+    int newNode(int symbol, int level) {
+        nodes.push_back({symbol, level, {}, {}});
+        statistics.nodes++;
+        if (nodes.size() == 1) {
+            nodes[0].below.push_back(EMPTY);
+            statistics.edges++;
+        }
+        return nodes.size() - 1;
+    }
+
+    int findNode(int symbol, int state, int level) {
+        auto it = node_index.find(key(symbol, state));
+        if (it != node_index.end()) return it->second;
+        int id = newNode(symbol, level);
+        node_index[key(symbol, state)] = id;
+        return id;
+    }
+
+    bool addEdge(int from, int to) {
+        if (!edge_seen.insert(key(from, to)).second) return false;
+        nodes[from].below.push_back(to);
+        statistics.edges++;
+        return true;
+    }
+
+    void measureLive(const std::vector<std::pair<int, int>>& configurations, int stamp) {
+        visited.resize(nodes.size(), -1);
+        std::vector<int> stack;
+        size_t live_nodes = 0, live_edges = 0;
+        for (auto [state, node] : configurations) {
+            if (node != EMPTY && visited[node] != stamp) {
+                visited[node] = stamp;
+                stack.push_back(node);
+            }
+        }
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            live_nodes++;
+            for (int below : nodes[node].below) {
+                live_edges++;
+                if (below != EMPTY && visited[below] != stamp) {
+                    visited[below] = stamp;
+                    stack.push_back(below);
+                }
+            }
+        }
+        statistics.peak_live_nodes = std::max(statistics.peak_live_nodes, live_nodes);
+        statistics.peak_live_edges = std::max(statistics.peak_live_edges, live_edges);
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "parallelCYK.hpp"
+
+/**
+ * @brief Recognize every line of a stream against one compiled grammar
+ * Procedure
+ * 1. Read the input in blocks of lines
+ * 2. Worker threads take lines of the block from an atomic counter, each
+ *    worker owns one BitCYKTable whose buffers are reused for every line
+ * 3. Results of the block are written in input order, one "accept" or
+ *    "reject" per line, before the next block is read
+ *
+ * @param in one input string per line
+ * @param out one result per line
+ * @param grammar compiled once by the caller
+ * @param threads number of worker threads, 0 uses every hardware thread
+ * @return number of accepted lines
+ */
+
+size_t batchRecognize(std::istream& in, std::ostream& out, const CompiledGrammar& grammar, int threads = 0) {
+    const size_t block_lines = 1 << 16;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<BitCYKTable> tables(threads);
+    std::vector<std::string> lines;
+    std::vector<char> accepted;
+    std::string output;
+    size_t total_accepted = 0;
+
+    while (true) {
+        lines.clear();
+        std::string line;
+        while (lines.size() < block_lines && std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            lines.push_back(std::move(line));
+        }
+        if (lines.empty()) break;
+
+        accepted.assign(lines.size(), 0);
+        std::atomic<size_t> next_line(0);
+        auto worker = [&](int t) {
+            for (size_t i = next_line++; i < lines.size(); i = next_line++) {
+                bitCYK(lines[i], grammar, tables[t]);
+                accepted[i] = bitCYKAccepts(tables[t], grammar);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto& thread : pool) thread.join();
+
+        output.clear();
+        for (char result : accepted) {
+            output += result ? "accept\n" : "reject\n";
+            total_accepted += result;
+        }
+        out << output;
+    }
+    out.flush();
+    return total_accepted;
+}
@@ -0,0 +1,509 @@
+#include "valiantCYK.hpp"
+#include "incrementalCYK.hpp"
+#include "Earley.hpp"
+#include "LL1.hpp"
+#include "tokenCYK.hpp"
+#include "viterbiCYK.hpp"
+#include "parallelCYK.hpp"
+
+// Benchmarks for the CFG engines
+// g++ -O2 -std=c++17 -pthread bench.cpp -o bench && ./bench
+
+double secondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class F>
+double timeIt(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return secondsSince(start);
+}
+
+std::string randomString(int n, const std::string& alphabet, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string s;
+    for (int i = 0; i < n; i++) s += alphabet[rng() % alphabet.size()];
+    return s;
+}
+
+/**
+ * @brief CNF grammar of balanced brackets with kinds bracket kinds
+ * S -> L_t R_t | L_t X_t | S S,  X_t -> S R_t,  L_t -> open_t,  R_t -> close_t
+ * a nearly deterministic grammar whose tables stay sparse
+ */
+
+Grammar bracketGrammar(int kinds) {
+    Grammar grammar;
+    for (int t = 0; t < kinds; t++) {
+        std::string l = "L" + std::to_string(t), r = "R" + std::to_string(t), x = "X" + std::to_string(t);
+        grammar["S"].push_back({l, r});
+        grammar["S"].push_back({l, x});
+        grammar[x].push_back({"S", r});
+        grammar[l].push_back({std::string(1, char(33 + t))});
+        grammar[r].push_back({std::string(1, char(33 + kinds + t))});
+    }
+    grammar["S"].push_back({"S", "S"});
+    return grammar;
+}
+
+std::string bracketString(int n, int kinds, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string s;
+    std::vector<int> stack;
+    for (int i = 0; i < n; i++) {
+        if (!stack.empty() && (rng() % 2 || n - i <= stack.size())) {
+            s += char(33 + kinds + stack.back());
+            stack.pop_back();
+        } else {
+            int t = rng() % kinds;
+            stack.push_back(t);
+            s += char(33 + t);
+        }
+    }
+    return s;
+}
+
+// a random valid expression of about n symbols for E -> E + T | T, T -> T * F | F, F -> ( E ) | x
+std::string expressionString(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string s;
+    int open = 0;
+    while (true) {
+        if (rng() % 4 == 0 && s.size() + open + 3 < n) {
+            s += '(';
+            open++;
+            continue;
+        }
+        s += 'x';
+        while (open && rng() % 3 == 0) {
+            s += ')';
+            open--;
+        }
+        if (s.size() + open + 1 >= n) break;
+        s += "+*"[rng() % 2];
+    }
+    s += std::string(open, ')');
+    return s;
+}
+
+/**
+ * @brief Classic cyk(), bitset CYK and the matrix multiplication recognizer on growing inputs
+ * lengths are 2^k - 1 so the recognizer works on exactly 2^k positions
+ */
+
+void benchValiantCrossover() {
+    std::cout << "== CYK table fill vs boolean matrix multiplication ==\n";
+    Grammar ambiguous = readCFG("cfg.txt");
+    Grammar brackets = bracketGrammar(20);
+    std::vector<std::tuple<std::string, Grammar*, std::function<std::string(int)>>> cases = {
+        {"cfg.txt", &ambiguous, [](int n) { return randomString(n, "ab", n); }},
+        {"brackets", &brackets, [](int n) { return bracketString(n, 20, n); }},
+    };
+
+    for (auto& [name, grammar, make_input] : cases) {
+        CompiledGrammar compiled(*grammar, "S");
+        std::cout << name << " : n classic_s bitset_s valiant_s\n";
+        for (int n : {31, 63, 127, 255, 511, 1023}) {
+            std::string input = make_input(n);
+            bool classic = false, bitset = false, valiant = false;
+            std::string classic_time = "-";
+            if (n <= 127) {
+                classic_time = std::to_string(timeIt([&] { classic = cyk(input, *grammar, "S")[0][n - 1].count("S") > 0; }));
+            }
+            double bitset_time = timeIt([&] { bitset = bitCYKAccepts(bitCYK(input, compiled), compiled); });
+            double valiant_time = timeIt([&] { valiant = ValiantCYK(compiled).recognize(input); });
+            if (bitset != valiant || (n <= 127 && classic != bitset)) {
+                throw std::runtime_error("recognizers disagree");
+            }
+            std::cout << n << " " << classic_time << " " << bitset_time << " " << valiant_time << "\n";
+        }
+    }
+}
+
+/**
+ * @brief parallelBitCYK on long inputs with 1, 2, 4 ... threads up to the hardware threads
+ * against bitCYK, every cell of the parallel table must equal the sequential one.
+ * At least 2 threads always run so the barrier path is checked on a single core too
+ */
+
+void benchParallelCYK() {
+    std::cout << "== parallel bitset CYK ==\n";
+    Grammar ambiguous = readCFG("cfg.txt");
+    Grammar brackets = bracketGrammar(20);
+    std::vector<std::tuple<std::string, Grammar*, std::string>> cases = {
+        {"cfg.txt", &ambiguous, randomString(1000, "ab", 41)},
+        {"brackets", &brackets, bracketString(3000, 20, 41)},
+    };
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < std::max(2, hardware); threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(std::max(2, hardware));
+
+    for (auto& [name, grammar, input] : cases) {
+        CompiledGrammar compiled(*grammar, "S");
+        int n = input.size();
+        BitCYKTable sequential;
+        double sequential_time = timeIt([&] { sequential = bitCYK(input, compiled); });
+        std::cout << name << " : n=" << n << " bitCYK_s=" << sequential_time << " hardware_threads=" << hardware << "\n";
+        std::cout << "threads seconds speedup same_table\n";
+        for (int threads : thread_counts) {
+            BitCYKTable parallel;
+            double parallel_time = timeIt([&] { parallel = parallelBitCYK(input, compiled, threads); });
+            bool same = true;
+            for (int i = 0; i < n && same; i++) {
+                for (int j = i; j < n && same; j++) {
+                    same = std::equal(sequential.cell(i, j), sequential.cell(i, j) + compiled.words, parallel.cell(i, j));
+                }
+            }
+            if (!same) {
+                throw std::runtime_error("parallelBitCYK differs from bitCYK with " + std::to_string(threads) + " threads");
+            }
+            std::cout << threads << " " << parallel_time << " " << sequential_time / parallel_time << " yes\n";
+        }
+    }
+}
+
+/**
+ * @brief Random single symbol edits, incremental update vs a full bitset CYK rebuild
+ */
+
+void benchIncrementalEdits() {
+    std::cout << "== incremental CYK after single symbol edits ==\n";
+    const int kinds = 20, edits = 200;
+    Grammar brackets = bracketGrammar(kinds);
+    CompiledGrammar compiled(brackets, "S");
+    std::cout << "n recomputed_cells full_cells incremental_s full_s\n";
+    for (int n : {250, 500, 1000}) {
+        std::string input = bracketString(n, kinds, n);
+        IncrementalCYK incremental(compiled);
+        incremental.assign(input);
+        std::mt19937 rng(n);
+        size_t recomputed = 0, full = 0;
+        double incremental_time = 0, full_time = 0;
+        for (int e = 0; e < edits; e++) {
+            int p = rng() % input.size();
+            char symbol = char(33 + rng() % (2 * kinds));
+            int op = rng() % 3;
+            incremental_time += timeIt([&] {
+                if (op == 0) incremental.replace(p, symbol);
+                else if (op == 1) incremental.insert(p, symbol);
+                else incremental.erase(p);
+            });
+            if (op == 0) input[p] = symbol;
+            else if (op == 1) input.insert(input.begin() + p, symbol);
+            else input.erase(input.begin() + p);
+            recomputed += incremental.lastRecomputed();
+            full += incremental.fullRebuildCells();
+
+            bool rebuilt = false;
+            full_time += timeIt([&] { rebuilt = bitCYKAccepts(bitCYK(input, compiled), compiled); });
+            if (rebuilt != incremental.accepts()) throw std::runtime_error("incremental CYK disagrees");
+        }
+        std::cout << n << " " << recomputed << " " << full << " " << incremental_time << " " << full_time << "\n";
+    }
+}
+
+/**
+ * @brief Earley on the grammar as written against cyk() and bitset CYK on its CNF
+ * the same inputs go to every engine, cyk() only up to 255 symbols
+ */
+
+void benchEarley() {
+    std::cout << "== Earley vs CYK ==\n";
+    Grammar expression = {
+        {"E", {{"E", "+", "T"}, {"T"}}},
+        {"T", {{"T", "*", "F"}, {"F"}}},
+        {"F", {{"(", "E", ")"}, {"x"}}},
+    };
+    Grammar right_recursive = {{"S", {{"a", "S"}, {"a"}}}};
+    Grammar ambiguous = readCFG("cfg.txt");
+    struct Case {
+        std::string name;
+        Grammar* grammar;
+        std::string start;
+        std::function<std::string(int)> make_input;
+    };
+    std::vector<Case> cases = {
+        {"expression", &expression, "E", [](int n) { return expressionString(n, n); }},
+        {"a S | a", &right_recursive, "S", [](int n) { return std::string(n, 'a'); }},
+        {"cfg.txt", &ambiguous, "S", [](int n) { return randomString(n, "ab", n); }},
+    };
+
+    for (auto& [name, grammar, start, make_input] : cases) {
+        CNFResult cnf = toCNF(*grammar, start);
+        CompiledGrammar compiled(cnf.grammar, cnf.start_symbol);
+        EarleyParser earley(*grammar, start);
+        std::cout << name << " (CNF " << cnf.after.productions << " productions) : n classic_s bitset_s earley_s earley_without_leo_s\n";
+        for (int n : {64, 256, 1024}) {
+            std::string input = make_input(n);
+            bool classic = false, bitset = false, with_leo = false, without_leo = false;
+            std::string classic_time = "-";
+            if (n <= 256) {
+                classic_time = std::to_string(timeIt([&] {
+                    classic = cyk(input, cnf.grammar, cnf.start_symbol)[0][input.size() - 1].count(cnf.start_symbol) > 0;
+                }));
+            }
+            double bitset_time = timeIt([&] { bitset = bitCYKAccepts(bitCYK(input, compiled), compiled); });
+            double earley_time = timeIt([&] { with_leo = earley.recognize(input); });
+            double plain_time = timeIt([&] { without_leo = earley.recognize(input, false); });
+            if (bitset != with_leo || with_leo != without_leo || (n <= 256 && classic != bitset)) {
+                throw std::runtime_error("recognizers disagree");
+            }
+            std::cout << input.size() << " " << classic_time << " " << bitset_time << " " << earley_time << " " << plain_time << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Predictive LL(1) parsing against Earley and bitset CYK on the expression grammar
+ * the LL(1) parser works on the grammar after left recursion elimination and left factoring
+ */
+
+void benchLL1() {
+    std::cout << "== LL(1) vs Earley vs CYK ==\n";
+    Grammar expression = {
+        {"E", {{"E", "+", "T"}, {"T"}}},
+        {"T", {{"T", "*", "F"}, {"F"}}},
+        {"F", {{"(", "E", ")"}, {"x"}}},
+    };
+    LL1Parser ll1(expression, "E");
+    if (!ll1.isLL1()) throw std::runtime_error("expression grammar should be LL(1)");
+    EarleyParser earley(expression, "E");
+    CNFResult cnf = toCNF(expression, "E");
+    CompiledGrammar compiled(cnf.grammar, cnf.start_symbol);
+    std::cout << "n ll1_s earley_s bitset_s\n";
+    for (int n : {1000, 4000, 16000}) {
+        std::string input = expressionString(n, n);
+        bool predictive = false, chart = false, bitset = false;
+        double ll1_time = timeIt([&] { predictive = ll1.parse(input).has_value(); });
+        double earley_time = timeIt([&] { chart = earley.recognize(input); });
+        std::string bitset_time = "-";
+        if (n <= 4000) bitset_time = std::to_string(timeIt([&] { bitset = bitCYKAccepts(bitCYK(input, compiled), compiled); }));
+        if (!predictive || !chart || (n <= 4000 && !bitset)) throw std::runtime_error("expression rejected");
+        std::cout << input.size() << " " << ll1_time << " " << earley_time << " " << bitset_time << "\n";
+    }
+}
+
+/**
+ * @brief A generated grammar full of dead weight : the bracket grammar with every rule
+ * repeated, plus families of unreachable and non generating nonterminals
+ */
+
+Grammar bloatedGrammar(int kinds, int copies, int unreachable, int non_generating) {
+    Grammar grammar = bracketGrammar(kinds);
+    for (auto& [non_terminal, productions] : grammar) {
+        std::vector<std::vector<std::string>> repeated;
+        for (int c = 0; c < copies; c++) repeated.insert(repeated.end(), productions.begin(), productions.end());
+        productions = repeated;
+    }
+    for (int u = 0; u < unreachable; u++) {
+        std::string name = "U" + std::to_string(u), next = "U" + std::to_string((u + 1) % unreachable);
+        grammar[name] = {{name, "S"}, {"S", next}, {std::string(1, char(33 + u % (2 * kinds)))}};
+    }
+    for (int g = 0; g < non_generating; g++) {
+        std::string name = "N" + std::to_string(g), next = "N" + std::to_string((g + 1) % non_generating);
+        grammar[name] = {{next, "S"}, {"S", next}};
+        grammar["S"].push_back({"S", name}); // reachable, but never finishes a derivation
+    }
+    return grammar;
+}
+
+void benchGrammarOptimizer() {
+    std::cout << "== grammar optimization before CYK ==\n";
+    Grammar bloated = bloatedGrammar(20, 4, 400, 100);
+    OptimizedGrammar optimized = optimizeGrammar(bloated, "S");
+    optimized.report.print(std::cout);
+    std::cout << "n classic_raw_s classic_optimized_s\n";
+    for (int n : {16, 32}) {
+        std::string input = bracketString(n, 20, n);
+        bool raw = false, lean = false;
+        double raw_time = timeIt([&] { raw = cyk(input, bloated, "S")[0][n - 1].count("S") > 0; });
+        double lean_time = timeIt([&] { lean = cyk(input, optimized.grammar, "S")[0][n - 1].count("S") > 0; });
+        if (raw != lean) throw std::runtime_error("optimized grammar disagrees");
+        std::cout << n << " " << raw_time << " " << lean_time << "\n";
+    }
+}
+
+/**
+ * @brief Token level CYK against character CYK on the same expressions
+ * The expression grammar has word terminals id, num, +, *, ( and ). Token mode reads a
+ * memory mapped file and runs CYK over one cell per token, character mode spells every
+ * word out and runs CYK over one cell per character
+ */
+
+void benchTokenCYK() {
+    std::cout << "== token level CYK ==\n";
+    Grammar words = {{"E", {{"E", "+", "T"}, {"T"}}}, {"T", {{"T", "*", "F"}, {"F"}}}, {"F", {{"(", "E", ")"}, {"id"}, {"num"}}}};
+    CNFResult token_cnf = toCNF(words, "E", false), char_cnf = toCNF(words, "E");
+    CompiledGrammar token_grammar(token_cnf.grammar, token_cnf.start_symbol);
+    CompiledGrammar char_grammar(char_cnf.grammar, char_cnf.start_symbol);
+    std::string filename = "bench_tokens.txt";
+
+    std::cout << "tokens chars istream_read_s mmap_read_s token_cyk_s char_cyk_s\n";
+    for (int n : {255, 511, 1023}) {
+        std::string expression = expressionString(n, n), text, spelled;
+        std::mt19937 rng(n);
+        for (char c : expression) {
+            std::string token = c == 'x' ? (rng() % 2 ? "id" : "num") : std::string(1, c);
+            text += token + " ";
+            spelled += token;
+        }
+        std::ofstream(filename) << text;
+
+        std::vector<int> streamed, mapped;
+        double istream_time = timeIt([&] {
+            std::ifstream file(filename);
+            std::string token;
+            while (file >> token) streamed.push_back(token_grammar.terminalId(token));
+        });
+        double mmap_time = timeIt([&] {
+            MappedFile file(filename);
+            mapped = tokenIds(file.text(), token_grammar);
+        });
+        bool by_token = false, by_char = false;
+        double token_time = timeIt([&] { by_token = bitCYKAccepts(bitCYK(mapped, token_grammar), token_grammar); });
+        double char_time = timeIt([&] { by_char = bitCYKAccepts(bitCYK(spelled, char_grammar), char_grammar); });
+        if (streamed != mapped || !by_token || !by_char) throw std::runtime_error("token CYK disagrees");
+        std::cout << mapped.size() << " " << spelled.size() << " " << istream_time << " " << mmap_time << " "
+                  << token_time << " " << char_time << "\n";
+    }
+
+    // reading alone on a large file, where the copy through the stream shows
+    std::string text;
+    for (int i = 0; text.size() < (64 << 20); i++) text += i % 3 ? "id + " : "( num * id ) * ";
+    std::ofstream(filename) << text;
+    size_t streamed = 0, mapped = 0;
+    double istream_time = timeIt([&] {
+        std::ifstream file(filename);
+        std::string token;
+        while (file >> token) streamed += token_grammar.terminalId(token) >= 0;
+    });
+    double mmap_time = timeIt([&] {
+        MappedFile file(filename);
+        for (int id : tokenIds(file.text(), token_grammar)) mapped += id >= 0;
+    });
+    if (streamed != mapped) throw std::runtime_error("token readers disagree");
+    std::cout << "read " << (text.size() >> 20) << " MB, " << mapped << " tokens : istream " << istream_time
+              << " s, mmap " << mmap_time << " s\n";
+    std::remove(filename.c_str());
+}
+
+/**
+ * @brief Random weighted CNF grammar over nonterminals N0 .. N(k-1), N0 is the start.
+ * Every nonterminal has three terminal rules sharing terminal_mass and binary rules
+ * sharing the rest, weights inside each group are log normal so some rules dominate
+ */
+
+WeightedGrammar randomPCFG(int non_terminals, int binary_per_symbol, double terminal_mass, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> skew(0, 1.5);
+    WeightedGrammar grammar;
+    for (int a = 0; a < non_terminals; a++) {
+        auto& productions = grammar["N" + std::to_string(a)];
+        auto group = [&](int count, double mass, auto rhs) {
+            std::vector<double> weights;
+            double total = 0;
+            for (int r = 0; r < count; r++) {
+                weights.push_back(std::exp(skew(rng)));
+                total += weights.back();
+            }
+            for (int r = 0; r < count; r++) productions.push_back({rhs(), std::log(weights[r] / total * mass)});
+        };
+        group(3, terminal_mass, [&] { return std::vector<std::string>{std::string(1, char('a' + rng() % 8))}; });
+        group(binary_per_symbol, 1 - terminal_mass, [&] {
+            return std::vector<std::string>{"N" + std::to_string(rng() % non_terminals), "N" + std::to_string(rng() % non_terminals)};
+        });
+    }
+    return grammar;
+}
+
+// a sentence drawn from the grammar, empty when it would be longer than limit
+std::string samplePCFG(const WeightedGrammar& grammar, const std::string& start_symbol, int limit, std::mt19937& rng) {
+    std::string sentence;
+    std::vector<std::string> pending = {start_symbol};
+    std::uniform_real_distribution<double> uniform(0, 1);
+    while (!pending.empty()) {
+        if (sentence.size() + pending.size() > limit) return "";
+        std::string symbol = pending.back();
+        pending.pop_back();
+        auto it = grammar.find(symbol);
+        if (it == grammar.end()) {
+            sentence += symbol;
+            continue;
+        }
+        double r = uniform(rng);
+        const auto& productions = it->second;
+        int p = 0;
+        for (; p + 1 < productions.size(); p++) {
+            r -= std::exp(productions[p].log_prob);
+            if (r <= 0) break;
+        }
+        pending.insert(pending.end(), productions[p].symbols.rbegin(), productions[p].symbols.rend());
+    }
+    return sentence;
+}
+
+/**
+ * @brief Beam and threshold pruning against the exhaustive Viterbi parse on sentences
+ * sampled from the grammar
+ * exact : the pruned parse has the exhaustive best log probability
+ * loss  : mean log probability lost over the sentences the pruned run still parses
+ */
+
+void benchViterbi() {
+    std::cout << "== Viterbi CYK pruning ==\n";
+    WeightedGrammar grammar = randomPCFG(40, 16, 0.55, 44);
+    ViterbiCYK parser(grammar, "N0");
+    std::mt19937 rng(44);
+    std::vector<std::string> sentences;
+    while (sentences.size() < 20) {
+        std::string sentence = samplePCFG(grammar, "N0", 40, rng);
+        if (sentence.size() >= 25) sentences.push_back(sentence);
+    }
+
+    std::vector<std::optional<double>> exact_scores;
+    size_t exhaustive_rules = 0;
+    double exhaustive_time = timeIt([&] {
+        for (const auto& sentence : sentences) {
+            exact_scores.push_back(parser.parse(sentence));
+            exhaustive_rules += parser.rulesApplied();
+        }
+    });
+
+    std::cout << "setting parsed exact loss rule_applications time_s speedup\n";
+    std::cout << "exhaustive " << sentences.size() << "/" << sentences.size() << " " << sentences.size() << "/" << sentences.size()
+              << " 0 " << exhaustive_rules << " " << exhaustive_time << " 1\n";
+    auto run = [&](const std::string& setting, int beam, double threshold) {
+        int parsed = 0, exact = 0;
+        size_t rules = 0;
+        double loss = 0;
+        double time = timeIt([&] {
+            for (int s = 0; s < sentences.size(); s++) {
+                std::optional<double> score = parser.parse(sentences[s], beam, threshold);
+                rules += parser.rulesApplied();
+                if (!score) continue;
+                parsed++;
+                exact += std::abs(*score - *exact_scores[s]) < 1e-9;
+                loss += *exact_scores[s] - *score;
+            }
+        });
+        std::cout << setting << " " << parsed << "/" << sentences.size() << " " << exact << "/" << sentences.size() << " "
+                  << (parsed ? loss / parsed : 0) << " " << rules << " " << time << " " << exhaustive_time / time << "\n";
+    };
+    for (int beam : {1, 2, 4, 8, 16, 32}) run("beam=" + std::to_string(beam), beam, std::numeric_limits<double>::infinity());
+    for (double threshold : {2.0, 5.0, 10.0}) run("threshold=" + std::to_string((int)threshold), 0, threshold);
+    run("beam=16,threshold=5", 16, 5.0);
+}
+
+int main() {
+    benchValiantCrossover();
+    benchParallelCYK();
+    benchIncrementalEdits();
+    benchEarley();
+    benchLL1();
+    benchGrammarOptimizer();
+    benchTokenCYK();
+    benchViterbi();
+    return 0;
+}
@@ -0,0 +1,343 @@
+#pragma once
+#include "grammarOptimizer.hpp"
+
+// Sets of nonterminals are bitsets of a fixed number of 64 bit words
+using Word = uint64_t;
+
+inline void setBit(Word* bits, int index) {
+    bits[index >> 6] |= Word(1) << (index & 63);
+}
+
+inline bool testBit(const Word* bits, int index) {
+    return bits[index >> 6] >> (index & 63) & 1;
+}
+
+/**
+ * @brief CNF grammar compiled for the bitset CYK
+ * Nonterminals are interned to 0..N-1 and every set of them is W = ceil(N/64) words.
+ * Terminals are interned as well and unit rules A -> a become one mask per terminal,
+ * a terminal may be a whole word when the input is a token stream. Binary rules
+ * A -> B C are indexed by (B, C) :
+ *   partners[B]     mask of every C that follows B in some rule
+ *   heads(B, C)     mask of every A with A -> B C
+ * so a split point costs one AND with partners[B] per B of the left cell and
+ * one OR of heads(B, C) per surviving C, instead of a scan of the whole grammar.
+ */
+
+class CompiledGrammar {
+public:
+    CompiledGrammar(const Grammar& input_grammar, const std::string& start_symbol) {
+        // useless symbols and duplicate rules go first, nonterminals are interned breadth first from the start
+        OptimizedGrammar optimized = optimizeGrammar(input_grammar, start_symbol);
+        optimization = optimized.report;
+        const Grammar& grammar = optimized.grammar;
+        intern(start_symbol);
+        for (const auto& non_terminal : optimized.order) intern(non_terminal);
+        start = ids[start_symbol];
+        words = std::max(1, (numNonTerminals() + 63) / 64);
+        std::fill(std::begin(char_terminal), std::end(char_terminal), -1);
+
+        int n = numNonTerminals();
+        partners.assign(n, std::vector<Word>(words, 0));
+        pair_slot.assign(n * n, -1);
+
+        for (const auto& [non_terminal, productions] : grammar) {
+            int a = ids[non_terminal];
+            for (const auto& prod : productions) {
+                if (prod.size() == 1 && !grammar.count(prod[0])) {
+                    setBit(&terminal_masks[internTerminal(prod[0]) * words], a);
+                } else if (prod.size() == 2 && grammar.count(prod[0]) && grammar.count(prod[1])) {
+                    int b = ids[prod[0]], c = ids[prod[1]];
+                    setBit(partners[b].data(), c);
+                    int& slot = pair_slot[b * n + c];
+                    if (slot < 0) {
+                        slot = pairs.size();
+                        pairs.push_back({b, c});
+                        heads.resize(heads.size() + words, 0);
+                    }
+                    setBit(&heads[slot * words], a);
+                    binary_rules++;
+                }
+            }
+        }
+    }
+
+    int numNonTerminals() const {
+        return names.size();
+    }
+
+    int id(const std::string& non_terminal) const {
+        auto it = ids.find(non_terminal);
+        return it == ids.end() ? -1 : it->second;
+    }
+
+    const std::string& name(int id) const {
+        return names[id];
+    }
+
+    int numTerminals() const {
+        return terminal_names.size();
+    }
+
+    // terminals are interned in the order their unit rules are compiled, -1 if no unit rule reads it
+    int terminalId(const std::string& terminal) const {
+        auto it = terminal_ids.find(terminal);
+        return it == terminal_ids.end() ? -1 : it->second;
+    }
+
+    const std::string& terminalName(int id) const {
+        return terminal_names[id];
+    }
+
+    // mask of nonterminals with a unit rule for the terminal, nullptr if none
+    const Word* terminalMask(const std::string& terminal) const {
+        return terminalMaskById(terminalId(terminal));
+    }
+
+    // one character terminals are looked up in a table, no string is built per input symbol
+    const Word* terminalMask(char symbol) const {
+        return terminalMaskById(char_terminal[(unsigned char)symbol]);
+    }
+
+    const Word* terminalMaskById(int id) const {
+        return id < 0 ? nullptr : &terminal_masks[(size_t)id * words];
+    }
+
+    const Word* partnerMask(int b) const {
+        return partners[b].data();
+    }
+
+    const Word* headMask(int b, int c) const {
+        return &heads[pair_slot[b * numNonTerminals() + c] * words];
+    }
+
+    // distinct (B, C) right hand sides, the index is the slot of headMaskBySlot
+    const std::vector<std::pair<int, int>>& binaryPairs() const {
+        return pairs;
+    }
+
+    const Word* headMaskBySlot(int slot) const {
+        return &heads[slot * words];
+    }
+
+    // what optimizeGrammar removed before compiling
+    const GrammarReport& report() const {
+        return optimization;
+    }
+
+    int words;
+    int start;
+    int binary_rules = 0;
+
+private:
+    GrammarReport optimization;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+    std::vector<std::string> terminal_names;
+    std::unordered_map<std::string, int> terminal_ids;
+    std::vector<Word> terminal_masks; // numTerminals() x words
+    int char_terminal[256];
+    std::vector<std::vector<Word>> partners;
+    std::vector<int> pair_slot;
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<Word> heads;
+
+    void intern(const std::string& non_terminal) {
+        if (ids.count(non_terminal)) return;
+        ids[non_terminal] = names.size();
+        names.push_back(non_terminal);
+    }
+
+    int internTerminal(const std::string& terminal) {
+        auto it = terminal_ids.find(terminal);
+        if (it != terminal_ids.end()) return it->second;
+        int id = terminal_names.size();
+        terminal_ids[terminal] = id;
+        terminal_names.push_back(terminal);
+        terminal_masks.resize(terminal_masks.size() + words, 0);
+        if (terminal.size() == 1) char_terminal[(unsigned char)terminal[0]] = id;
+        return id;
+    }
+};
+
+/**
+ * @brief CYK table whose cells are bitsets of nonterminals
+ * cell(i, j) is the set of nonterminals deriving input[i..j]
+ * Two occupancy bit matrices record which cells are non empty :
+ *   starts row i, bit k : cell(i, k) is non empty
+ *   ends   row j, bit k : cell(k + 1, j) is non empty
+ * ANDing row i of starts with row j of ends gives exactly the split points
+ * of cell(i, j) whose both halves are non empty, 64 split points per word
+ */
+
+class BitCYKTable {
+public:
+    BitCYKTable(int n = 0, int words = 1) {
+        reset(n, words);
+    }
+
+    // clear the table for an input of length n, the buffers keep their capacity
+    void reset(int n, int words) {
+        this->n = n;
+        this->words = words;
+        row_words = (n + 63) / 64;
+        bits.assign((size_t)n * n * words, 0);
+        starts.assign((size_t)n * row_words, 0);
+        ends.assign((size_t)n * row_words, 0);
+    }
+
+    Word* cell(int i, int j) {
+        return &bits[((size_t)i * n + j) * words];
+    }
+
+    const Word* cell(int i, int j) const {
+        return &bits[((size_t)i * n + j) * words];
+    }
+
+    bool has(int i, int j, int non_terminal) const {
+        return testBit(cell(i, j), non_terminal);
+    }
+
+    int size() const {
+        return n;
+    }
+
+    // record that cell(i, j) is non empty
+    void markNonEmpty(int i, int j) {
+        setBit(&starts[(size_t)i * row_words], j);
+        if (i > 0) setBit(&ends[(size_t)j * row_words], i - 1);
+    }
+
+    /**
+     * @brief Call f(k) for every split point k in [i, j) with both halves non empty
+     */
+
+    template <class F>
+    void forEachSplit(int i, int j, F f) const {
+        const Word* start_row = &starts[(size_t)i * row_words];
+        const Word* end_row = &ends[(size_t)j * row_words];
+        for (int w = i >> 6; w <= (j - 1) >> 6; w++) {
+            Word splits = start_row[w] & end_row[w];
+            if (w == i >> 6) splits &= ~Word(0) << (i & 63);
+            if (w == (j - 1) >> 6 && ((j - 1) & 63) != 63) splits &= (Word(1) << (((j - 1) & 63) + 1)) - 1;
+            for (; splits; splits &= splits - 1) {
+                f(w * 64 + __builtin_ctzll(splits));
+            }
+        }
+    }
+
+    // same shape as the table returned by cyk(), for visualizeCYKTable
+    std::vector<std::vector<std::unordered_set<std::string>>> toSets(const CompiledGrammar& grammar) const {
+        std::vector<std::vector<std::unordered_set<std::string>>> table(n, std::vector<std::unordered_set<std::string>>(n));
+        for (int i = 0; i < n; i++) {
+            for (int j = i; j < n; j++) {
+                for (int a = 0; a < grammar.numNonTerminals(); a++) {
+                    if (has(i, j, a)) table[i][j].insert(grammar.name(a));
+                }
+            }
+        }
+        return table;
+    }
+
+private:
+    int n;
+    int words;
+    int row_words;
+    std::vector<Word> bits;
+    std::vector<Word> starts;
+    std::vector<Word> ends;
+};
+
+/**
+ * @brief Combine two cells over every binary rule : out |= { A | A -> B C, B in left, C in right }
+ * Procedure
+ * 1. For every B set in the left cell
+ * 2. AND the right cell with partners[B] to get the C's that can follow it
+ * 3. OR heads(B, C) into the output for every surviving C
+ */
+
+inline void combineCells(const CompiledGrammar& grammar, const Word* left, const Word* right, Word* out) {
+    const int words = grammar.words;
+    for (int wb = 0; wb < words; wb++) {
+        for (Word lb = left[wb]; lb; lb &= lb - 1) {
+            int b = wb * 64 + __builtin_ctzll(lb);
+            const Word* partner = grammar.partnerMask(b);
+            for (int wc = 0; wc < words; wc++) {
+                for (Word rc = right[wc] & partner[wc]; rc; rc &= rc - 1) {
+                    int c = wc * 64 + __builtin_ctzll(rc);
+                    const Word* head = grammar.headMask(b, c);
+                    for (int w = 0; w < words; w++) out[w] |= head[w];
+                }
+            }
+        }
+    }
+}
+
+inline bool emptyCell(const Word* cell, int words) {
+    for (int w = 0; w < words; w++) {
+        if (cell[w]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief CYK over the compiled grammar
+ * Same recurrence as cyk(), every cell is a bitset and every split is combineCells,
+ * split points with an empty half are skipped through the occupancy matrices.
+ * The diagonal comes from the interned terminal masks, one lookup per input symbol
+ *
+ * @param n length of the input
+ * @param grammar
+ * @param table filled in place, its buffers are reused between calls
+ * @param maskAt mask of the nonterminals deriving input symbol i, nullptr if none
+ */
+
+template <class MaskAt>
+void bitCYKSpans(int n, const CompiledGrammar& grammar, BitCYKTable& table, MaskAt maskAt) {
+    const int words = grammar.words;
+    table.reset(n, words);
+    for (int i = 0; i < n; i++) {
+        const Word* mask = maskAt(i);
+        if (mask) {
+            std::copy(mask, mask + words, table.cell(i, i));
+            table.markNonEmpty(i, i);
+        }
+    }
+
+    for (int len = 2; len <= n; len++) {
+        for (int i = 0; i <= n - len; i++) {
+            int j = i + len - 1;
+            Word* out = table.cell(i, j);
+            table.forEachSplit(i, j, [&](int k) {
+                combineCells(grammar, table.cell(i, k), table.cell(k + 1, j), out);
+            });
+            if (!emptyCell(out, words)) table.markNonEmpty(i, j);
+        }
+    }
+}
+
+// every character of the input is one terminal
+void bitCYK(const std::string& input, const CompiledGrammar& grammar, BitCYKTable& table) {
+    bitCYKSpans(input.size(), grammar, table, [&](int i) { return grammar.terminalMask(input[i]); });
+}
+
+// every token is one terminal, ids from CompiledGrammar::terminalId, -1 for a token no rule reads
+void bitCYK(const std::vector<int>& tokens, const CompiledGrammar& grammar, BitCYKTable& table) {
+    bitCYKSpans(tokens.size(), grammar, table, [&](int i) { return grammar.terminalMaskById(tokens[i]); });
+}
+
+BitCYKTable bitCYK(const std::string& input, const CompiledGrammar& grammar) {
+    BitCYKTable table;
+    bitCYK(input, grammar, table);
+    return table;
+}
+
+BitCYKTable bitCYK(const std::vector<int>& tokens, const CompiledGrammar& grammar) {
+    BitCYKTable table;
+    bitCYK(tokens, grammar, table);
+    return table;
+}
+
+bool bitCYKAccepts(const BitCYKTable& table, const CompiledGrammar& grammar) {
+    return table.size() > 0 && table.has(0, table.size() - 1, grammar.start);
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include "CYK.hpp"
+
+/**
+ * @brief Size of a grammar, the cost of CYK grows with the number of rules
+ */
+
+struct GrammarSize {
+    size_t non_terminals = 0;
+    size_t productions = 0;
+    size_t symbols = 0; // every rule counts its left side and its right side
+};
+
+GrammarSize grammarSize(const Grammar& grammar) {
+    GrammarSize size;
+    size.non_terminals = grammar.size();
+    for (const auto& [non_terminal, productions] : grammar) {
+        size.productions += productions.size();
+        for (const auto& prod : productions) {
+            size.symbols += 1 + prod.size();
+        }
+    }
+    return size;
+}
+
+std::ostream& operator<<(std::ostream& out, const GrammarSize& size) {
+    return out << size.non_terminals << " nonterminals, " << size.productions << " productions, " << size.symbols << " symbols";
+}
+
+// an empty right side, "ε" or "epsilon" all mean the empty string
+inline bool isEpsilonProduction(const std::vector<std::string>& prod) {
+    return prod.empty() || (prod.size() == 1 && (prod[0] == "ε" || prod[0] == "epsilon"));
+}
+
+struct GrammarReport {
+    GrammarSize before;
+    GrammarSize after;
+    std::vector<std::string> non_generating; // derive no terminal string
+    std::vector<std::string> unreachable;    // never reached from the start symbol
+    size_t duplicates = 0;
+    size_t dropped_rules = 0;                // rules through a removed nonterminal
+
+    bool changed() const {
+        return !non_generating.empty() || !unreachable.empty() || duplicates > 0 || dropped_rules > 0;
+    }
+
+    void print(std::ostream& out) const {
+        auto list = [&](const char* what, const std::vector<std::string>& symbols) {
+            if (symbols.empty()) return;
+            out << "removed " << symbols.size() << " " << what << " nonterminals :";
+            for (int k = 0; k < symbols.size() && k < 10; k++) out << " " << symbols[k];
+            out << (symbols.size() > 10 ? " ...\n" : "\n");
+        };
+        list("non generating", non_generating);
+        list("unreachable", unreachable);
+        if (duplicates) out << "removed " << duplicates << " duplicate productions\n";
+        if (dropped_rules) out << "removed " << dropped_rules << " productions using removed nonterminals\n";
+        out << "grammar : " << before << " -> " << after << "\n";
+    }
+};
+
+struct OptimizedGrammar {
+    Grammar grammar;
+    std::vector<std::string> order; // nonterminals breadth first from the start symbol
+    GrammarReport report;
+};
+
+/**
+ * @brief Remove everything that cannot take part in a derivation of the start symbol
+ * Procedure, on interned symbols
+ * 1. duplicate productions are dropped, an ε production counts as an empty right side
+ * 2. generating nonterminals by a worklist : every rule counts its nonterminals not yet
+ *    known to generate, a rule whose count drops to 0 makes its left side generating
+ * 3. rules with a non generating nonterminal are dropped
+ * 4. reachable nonterminals by a worklist from the start symbol over the remaining rules
+ * 5. nonterminals are ordered breadth first from the start symbol, the productions of
+ *    each one by length and then by symbol, so rules used together sit together
+ * Removing the non generating symbols first matters, a symbol can become unreachable
+ * only because the rules that reached it were dropped.
+ *
+ * @param grammar as read by readCFG
+ * @param start_symbol
+ * @return OptimizedGrammar the grammar, the order of its nonterminals and what was removed
+ */
+
+OptimizedGrammar optimizeGrammar(const Grammar& grammar, const std::string& start_symbol) {
+    OptimizedGrammar result;
+    result.report.before = grammarSize(grammar);
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+    auto intern = [&](const std::string& symbol) {
+        auto it = ids.find(symbol);
+        if (it != ids.end()) return it->second;
+        ids[symbol] = names.size();
+        names.push_back(symbol);
+        return (int)names.size() - 1;
+    };
+    std::vector<std::string> keys;
+    for (const auto& entry : grammar) keys.push_back(entry.first);
+    std::sort(keys.begin(), keys.end());
+    for (const auto& key : keys) intern(key);
+    const int non_terminals = keys.size(); // ids below this are nonterminals
+
+    std::vector<std::pair<int, std::vector<int>>> rules;
+    std::set<std::pair<int, std::vector<int>>> distinct;
+    for (const auto& key : keys) {
+        for (const auto& prod : grammar.at(key)) {
+            std::vector<int> rhs;
+            if (!isEpsilonProduction(prod)) {
+                for (const auto& symbol : prod) rhs.push_back(intern(symbol));
+            }
+            if (distinct.insert({ids[key], rhs}).second) rules.push_back({ids[key], rhs});
+            else result.report.duplicates++;
+        }
+    }
+
+    // generating
+    std::vector<int> missing(rules.size(), 0);
+    std::vector<std::vector<int>> used_in(non_terminals);
+    std::vector<bool> generating(non_terminals, false);
+    std::vector<int> worklist;
+    for (int r = 0; r < rules.size(); r++) {
+        for (int symbol : rules[r].second) {
+            if (symbol < non_terminals) {
+                missing[r]++;
+                used_in[symbol].push_back(r);
+            }
+        }
+        if (missing[r] == 0 && !generating[rules[r].first]) {
+            generating[rules[r].first] = true;
+            worklist.push_back(rules[r].first);
+        }
+    }
+    while (!worklist.empty()) {
+        int symbol = worklist.back();
+        worklist.pop_back();
+        for (int r : used_in[symbol]) {
+            if (--missing[r] == 0 && !generating[rules[r].first]) {
+                generating[rules[r].first] = true;
+                worklist.push_back(rules[r].first);
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> rules_of(non_terminals);
+    for (int r = 0; r < rules.size(); r++) {
+        if (missing[r] == 0) rules_of[rules[r].first].push_back(r);
+        else if (generating[rules[r].first]) result.report.dropped_rules++;
+    }
+
+    // reachable, breadth first so the order doubles as the layout
+    std::vector<bool> reachable(non_terminals, false);
+    auto start = ids.find(start_symbol);
+    if (start != ids.end() && start->second < non_terminals && generating[start->second]) {
+        reachable[start->second] = true;
+        result.order.push_back(start_symbol);
+        for (size_t head = 0; head < result.order.size(); head++) {
+            for (int r : rules_of[ids[result.order[head]]]) {
+                for (int symbol : rules[r].second) {
+                    if (symbol < non_terminals && !reachable[symbol]) {
+                        reachable[symbol] = true;
+                        result.order.push_back(names[symbol]);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int a = 0; a < non_terminals; a++) {
+        if (!generating[a]) result.report.non_generating.push_back(names[a]);
+        else if (!reachable[a]) result.report.unreachable.push_back(names[a]);
+    }
+
+    for (const auto& non_terminal : result.order) {
+        std::vector<int>& own = rules_of[ids[non_terminal]];
+        std::sort(own.begin(), own.end(), [&](int x, int y) {
+            const auto& left = rules[x].second;
+            const auto& right = rules[y].second;
+            return left.size() != right.size() ? left.size() < right.size() : left < right;
+        });
+        auto& productions = result.grammar[non_terminal];
+        for (int r : own) {
+            std::vector<std::string> prod;
+            for (int symbol : rules[r].second) prod.push_back(names[symbol]);
+            productions.push_back(prod);
+        }
+    }
+    result.report.after = grammarSize(result.grammar);
+    return result;
+}
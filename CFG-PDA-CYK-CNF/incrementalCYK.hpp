@@ -0,0 +1,162 @@
+#pragma once
+#include "bitCYK.hpp"
+
+/**
+ * @brief CYK table that follows single symbol edits of its input
+ * Only cells whose span covers the edited position p can change, every other
+ * cell is kept. Rows hold the cells starting at one position, row i stores
+ * cell(i, j) at (j - i) * words, so an insert or a delete moves whole rows
+ * and the cells right of p keep their contents under their new indices.
+ * Procedure after an edit at p
+ * 1. insert : a new row at p, every row left of p gets one more cell
+ *    delete : row p is removed, every row left of p loses its last cell
+ * 2. cells (i, j) with i <= p <= j are recomputed for j = p .. n - 1 and
+ *    i = p .. 0, every split they need is then either unchanged or already done
+ * That is (p + 1)(n - p) cells instead of n(n + 1) / 2 for a full rebuild.
+ * Every row also keeps one occupancy bit per cell, a split is only combined
+ * when its left cell is non empty and the bit of its right cell is set.
+ */
+
+class IncrementalCYK {
+public:
+    explicit IncrementalCYK(const CompiledGrammar& grammar) : grammar(grammar) {}
+
+    // replace the whole input, a full rebuild
+    void assign(const std::string& input) {
+        text = input;
+        rows.assign(text.size(), {});
+        row_nonempty.assign(text.size(), {});
+        for (int i = 0; i < text.size(); i++) {
+            resizeRow(i);
+        }
+        last_recomputed = 0;
+        for (int j = 0; j < text.size(); j++) {
+            for (int i = j; i >= 0; i--) {
+                recomputeCell(i, j);
+            }
+        }
+    }
+
+    void replace(int p, char symbol) {
+        checkPosition(p, text.size());
+        text[p] = symbol;
+        recompute(p);
+    }
+
+    // the new symbol ends up at position p
+    void insert(int p, char symbol) {
+        checkPosition(p, text.size() + 1);
+        text.insert(text.begin() + p, symbol);
+        rows.insert(rows.begin() + p, std::vector<Word>());
+        row_nonempty.insert(row_nonempty.begin() + p, std::vector<Word>());
+        for (int i = 0; i <= p; i++) {
+            resizeRow(i);
+        }
+        recompute(p);
+    }
+
+    void erase(int p) {
+        checkPosition(p, text.size());
+        text.erase(text.begin() + p);
+        rows.erase(rows.begin() + p);
+        row_nonempty.erase(row_nonempty.begin() + p);
+        for (int i = 0; i < p; i++) {
+            resizeRow(i);
+        }
+        // cells that spanned the deleted symbol now span the gap at p
+        recompute(p);
+    }
+
+    bool accepts() const {
+        return !text.empty() && testBit(cell(0, text.size() - 1), grammar.start);
+    }
+
+    bool has(int i, int j, int non_terminal) const {
+        return testBit(cell(i, j), non_terminal);
+    }
+
+    const Word* cell(int i, int j) const {
+        return &rows[i][(size_t)(j - i) * grammar.words];
+    }
+
+    const std::string& input() const {
+        return text;
+    }
+
+    int size() const {
+        return text.size();
+    }
+
+    // cells recomputed by the last edit
+    size_t lastRecomputed() const {
+        return last_recomputed;
+    }
+
+    // cells a full rebuild of the current input computes
+    size_t fullRebuildCells() const {
+        return (size_t)text.size() * (text.size() + 1) / 2;
+    }
+
+private:
+    const CompiledGrammar& grammar;
+    std::string text;
+    std::vector<std::vector<Word>> rows;
+    std::vector<std::vector<Word>> row_nonempty; // row i, bit j - i : cell(i, j) is non empty
+    size_t last_recomputed = 0;
+
+    Word* cell(int i, int j) {
+        return &rows[i][(size_t)(j - i) * grammar.words];
+    }
+
+    // bits of cells that no longer exist are cleared, so a row can grow again later
+    void resizeRow(int i) {
+        int cells = text.size() - i;
+        rows[i].resize((size_t)cells * grammar.words, 0);
+        row_nonempty[i].resize(cells / 64 + 1, 0);
+        if (cells & 63) row_nonempty[i].back() &= (Word(1) << (cells & 63)) - 1;
+        else row_nonempty[i].back() = 0;
+    }
+
+    bool nonEmpty(int i, int j) const {
+        return testBit(row_nonempty[i].data(), j - i);
+    }
+
+    void checkPosition(int p, int limit) const {
+        if (p < 0 || p >= limit) {
+            throw std::runtime_error("Edit position " + std::to_string(p) + " out of range");
+        }
+    }
+
+    // every cell (i, j) with i <= p <= j, deleting the last symbol leaves none
+    void recompute(int p) {
+        last_recomputed = 0;
+        for (int j = p; j < text.size(); j++) {
+            for (int i = p; i >= 0; i--) {
+                recomputeCell(i, j);
+            }
+        }
+    }
+
+    void recomputeCell(int i, int j) {
+        const int words = grammar.words;
+        Word* out = cell(i, j);
+        std::fill(out, out + words, 0);
+        if (i == j) {
+            const Word* mask = grammar.terminalMask(text[i]);
+            if (mask) std::copy(mask, mask + words, out);
+        } else {
+            const std::vector<Word>& starts = row_nonempty[i];
+            for (int w = 0; w <= (j - 1 - i) >> 6; w++) {
+                for (Word splits = starts[w]; splits; splits &= splits - 1) {
+                    int k = i + w * 64 + __builtin_ctzll(splits);
+                    if (k >= j) break;
+                    if (nonEmpty(k + 1, j)) combineCells(grammar, cell(i, k), cell(k + 1, j), out);
+                }
+            }
+        }
+        Word& bit = row_nonempty[i][(j - i) >> 6];
+        if (emptyCell(out, words)) bit &= ~(Word(1) << ((j - i) & 63));
+        else bit |= Word(1) << ((j - i) & 63);
+        last_recomputed++;
+    }
+};
@@ -0,0 +1,186 @@
+#pragma once
+#include "bitCYK.hpp"
+
+/**
+ * @brief Upper triangle of the CYK table packed into one contiguous bit array
+ * Only cells with i <= j exist and every cell takes exactly N bits (N nonterminals),
+ * with no padding to whole words. Cells are stored column by column (by their end j),
+ * cell(i, j) starts at bit (j * (j + 1) / 2 + i) * N, so the table can grow one
+ * column at a time while the input is read.
+ */
+
+class PackedCYKTable {
+public:
+    explicit PackedCYKTable(int non_terminals = 1) : non_terminals(non_terminals), words(std::max(1, (non_terminals + 63) / 64)) {}
+
+    int size() const {
+        return columns;
+    }
+
+    // append an empty column for the next input symbol
+    void addColumn() {
+        columns++;
+        size_t cells = (size_t)columns * (columns + 1) / 2;
+        bits.resize((cells * non_terminals + 63) / 64 + 1, 0); // one spare word for unaligned reads
+    }
+
+    // reserve room for n columns so the array does not move while it grows
+    void reserve(int n) {
+        bits.reserve(((size_t)n * (n + 1) / 2 * non_terminals + 63) / 64 + 1);
+    }
+
+    // copy cell(i, j) into out (words words)
+    void load(int i, int j, Word* out) const {
+        size_t first = offset(i, j);
+        for (int w = 0; w < words; w++) {
+            size_t bit = first + (size_t)w * 64;
+            size_t index = bit >> 6;
+            int shift = bit & 63;
+            Word value = bits[index] >> shift;
+            if (shift) value |= bits[index + 1] << (64 - shift);
+            int remaining = non_terminals - w * 64;
+            if (remaining < 64) value &= (Word(1) << remaining) - 1;
+            out[w] = value;
+        }
+    }
+
+    // OR the set in into cell(i, j)
+    void store(int i, int j, const Word* in) {
+        size_t first = offset(i, j);
+        for (int w = 0; w < words; w++) {
+            int remaining = non_terminals - w * 64;
+            Word value = remaining < 64 ? in[w] & ((Word(1) << remaining) - 1) : in[w];
+            size_t bit = first + (size_t)w * 64;
+            size_t index = bit >> 6;
+            int shift = bit & 63;
+            bits[index] |= value << shift;
+            if (shift) bits[index + 1] |= value >> (64 - shift);
+        }
+    }
+
+    bool has(int i, int j, int non_terminal) const {
+        size_t bit = offset(i, j) + non_terminal;
+        return bits[bit >> 6] >> (bit & 63) & 1;
+    }
+
+    size_t memoryBytes() const {
+        return bits.size() * sizeof(Word);
+    }
+
+private:
+    int non_terminals;
+    int words;
+    int columns = 0;
+    std::vector<Word> bits;
+
+    size_t offset(int i, int j) const {
+        return ((size_t)j * (j + 1) / 2 + i) * non_terminals;
+    }
+};
+
+/**
+ * @brief Left to right CYK that consumes the input one symbol at a time
+ * Procedure for the symbol at position j
+ * 1. cell(j, j) is the mask of the unit rules of the symbol
+ * 2. for i = j - 1 down to 0 : cell(i, j) combines cell(i, k) with cell(k + 1, j)
+ *    for every split k, the cells of column j that it needs are already done
+ * 3. the prefix input[0..j] is derivable iff the start symbol is in cell(0, j)
+ * Finished columns are packed into a PackedCYKTable, the current column is kept
+ * word aligned. Split points with an empty half are skipped with one occupancy
+ * bit per cell, kept per row, and one per cell of the current column.
+ */
+
+class OnlineCYK {
+public:
+    explicit OnlineCYK(const CompiledGrammar& grammar) : grammar(grammar), cells(grammar.numNonTerminals()) {}
+
+    // expected input length, avoids moving the packed table while it grows
+    void reserve(int n) {
+        cells.reserve(n);
+        row_nonempty.reserve(n);
+    }
+
+    /**
+     * @brief Consume the next input symbol
+     *
+     * @param symbol
+     * @return true if the input read so far is derivable from the start symbol
+     */
+
+    bool push(char symbol) {
+        const int words = grammar.words;
+        int j = cells.size();
+        cells.addColumn();
+        row_nonempty.emplace_back();
+        for (int i = 0; i <= j; i++) {
+            row_nonempty[i].resize(j / 64 + 1, 0);
+        }
+
+        // column[k * words] holds cell(k, j), column_nonempty bit k : cell(k + 1, j) is non empty
+        column.assign((size_t)(j + 1) * words, 0);
+        column_nonempty.assign(j / 64 + 1, 0);
+        left.resize(words);
+
+        const Word* mask = grammar.terminalMask(symbol);
+        if (mask) finishCell(j, j, mask);
+
+        for (int i = j - 1; i >= 0; i--) {
+            Word* out = &column[(size_t)i * words];
+            const Word* starts = row_nonempty[i].data();
+            for (int w = i >> 6; w <= (j - 1) >> 6; w++) {
+                Word splits = starts[w] & column_nonempty[w];
+                if (w == i >> 6) splits &= ~Word(0) << (i & 63);
+                for (; splits; splits &= splits - 1) {
+                    int k = w * 64 + __builtin_ctzll(splits);
+                    if (k >= j) break;
+                    cells.load(i, k, left.data());
+                    combineCells(grammar, left.data(), &column[(size_t)(k + 1) * words], out);
+                }
+            }
+            if (!emptyCell(out, words)) finishCell(i, j, out);
+        }
+        return accepts();
+    }
+
+    // the whole input read so far is derivable from the start symbol
+    bool accepts() const {
+        return cells.size() > 0 && cells.has(0, cells.size() - 1, grammar.start);
+    }
+
+    const PackedCYKTable& table() const {
+        return cells;
+    }
+
+private:
+    const CompiledGrammar& grammar;
+    PackedCYKTable cells;
+    std::vector<std::vector<Word>> row_nonempty; // row i, bit k : cell(i, k) is non empty
+    std::vector<Word> column;
+    std::vector<Word> column_nonempty;
+    std::vector<Word> left;
+
+    void finishCell(int i, int j, const Word* set) {
+        const int words = grammar.words;
+        if (set != &column[(size_t)i * words]) std::copy(set, set + words, &column[(size_t)i * words]);
+        cells.store(i, j, set);
+        setBit(row_nonempty[i].data(), j);
+        if (i > 0) setBit(column_nonempty.data(), i - 1);
+    }
+};
+
+/**
+ * @brief CYK into the packed triangular layout, the whole input at once
+ *
+ * @param input
+ * @param grammar
+ * @return PackedCYKTable
+ */
+
+PackedCYKTable packedCYK(const std::string& input, const CompiledGrammar& grammar) {
+    OnlineCYK online(grammar);
+    online.reserve(input.size());
+    for (const char& symbol : input) {
+        online.push(symbol);
+    }
+    return online.table();
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "bitCYK.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * @brief Reusable barrier, the last thread to arrive runs on_complete and releases the others
+ */
+
+class Barrier {
+public:
+    Barrier(int count, std::function<void()> on_complete) : count(count), waiting(0), generation(0), on_complete(on_complete) {}
+
+    void arriveAndWait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        int current = generation;
+        if (++waiting == count) {
+            on_complete();
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != current; });
+    }
+
+private:
+    int count;
+    int waiting;
+    int generation;
+    std::function<void()> on_complete;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/**
+ * @brief CYK that fills every anti-diagonal in parallel
+ * Cells of span length len only read cells of shorter spans, so the cells of one
+ * diagonal are independent. A fixed set of threads walks the diagonals together :
+ * cells of the current diagonal are handed out in chunks from an atomic counter and
+ * a barrier separates consecutive diagonals. Every cell writes only its own bitset
+ * and its own row of each occupancy matrix, so no locking is needed inside a diagonal.
+ * The table is identical to the one of bitCYK.
+ *
+ * @param input
+ * @param grammar
+ * @param threads number of worker threads, 0 uses every hardware thread
+ * @return BitCYKTable
+ */
+
+BitCYKTable parallelBitCYK(const std::string& input, const CompiledGrammar& grammar, int threads = 0) {
+    int n = input.size();
+    const int words = grammar.words;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    BitCYKTable table(n, words);
+    for (int i = 0; i < n; i++) {
+        const Word* mask = grammar.terminalMask(input[i]);
+        if (mask) {
+            std::copy(mask, mask + words, table.cell(i, i));
+            table.markNonEmpty(i, i);
+        }
+    }
+    if (n < 2) return table;
+
+    int len = 2;
+    std::atomic<int> next_cell(0);
+    Barrier barrier(threads, [&] {
+        len++;
+        next_cell = 0;
+    });
+
+    auto worker = [&]() {
+        while (len <= n) {
+            int cells = n - len + 1;
+            int chunk = std::max(1, cells / (threads * 8));
+            for (int first = next_cell.fetch_add(chunk); first < cells; first = next_cell.fetch_add(chunk)) {
+                int last = std::min(cells, first + chunk);
+                for (int i = first; i < last; i++) {
+                    int j = i + len - 1;
+                    Word* out = table.cell(i, j);
+                    table.forEachSplit(i, j, [&](int k) {
+                        combineCells(grammar, table.cell(i, k), table.cell(k + 1, j), out);
+                    });
+                    if (!emptyCell(out, words)) table.markNonEmpty(i, j);
+                }
+            }
+            barrier.arriveAndWait();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+    return table;
+}
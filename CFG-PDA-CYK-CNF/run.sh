@@ -1,2 +1,2 @@
-g++ CYK.cpp -std=c++17
-./a.out
\ No newline at end of file
+g++ CYK.cpp -std=c++17 -O2 -pthread
+./a.out
@@ -0,0 +1,346 @@
+#pragma once
+#include "bitCYK.hpp"
+
+/**
+ * @brief Unsigned integer of any size, only what derivation counting needs
+ * little endian base 2^32 limbs
+ */
+
+class BigCount {
+public:
+    BigCount(uint64_t value = 0) {
+        while (value) {
+            limbs.push_back(value & 0xFFFFFFFF);
+            value >>= 32;
+        }
+    }
+
+    BigCount& operator+=(const BigCount& other) {
+        if (limbs.size() < other.limbs.size()) limbs.resize(other.limbs.size(), 0);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < limbs.size(); i++) {
+            uint64_t sum = carry + limbs[i] + (i < other.limbs.size() ? other.limbs[i] : 0);
+            limbs[i] = sum & 0xFFFFFFFF;
+            carry = sum >> 32;
+        }
+        if (carry) limbs.push_back(carry);
+        return *this;
+    }
+
+    BigCount operator*(const BigCount& other) const {
+        BigCount product;
+        if (limbs.empty() || other.limbs.empty()) return product;
+        product.limbs.assign(limbs.size() + other.limbs.size(), 0);
+        for (size_t i = 0; i < limbs.size(); i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < other.limbs.size(); j++) {
+                uint64_t current = product.limbs[i + j] + (uint64_t)limbs[i] * other.limbs[j] + carry;
+                product.limbs[i + j] = current & 0xFFFFFFFF;
+                carry = current >> 32;
+            }
+            product.limbs[i + other.limbs.size()] += carry;
+        }
+        while (!product.limbs.empty() && product.limbs.back() == 0) product.limbs.pop_back();
+        return product;
+    }
+
+    std::string toString() const {
+        if (limbs.empty()) return "0";
+        std::vector<uint32_t> value = limbs;
+        std::string digits;
+        while (!value.empty()) {
+            uint64_t remainder = 0;
+            for (size_t i = value.size(); i-- > 0;) {
+                uint64_t current = (remainder << 32) | value[i];
+                value[i] = current / 1000000000;
+                remainder = current % 1000000000;
+            }
+            while (!value.empty() && value.back() == 0) value.pop_back();
+            for (int d = 0; d < 9; d++) {
+                digits += char('0' + remainder % 10);
+                remainder /= 10;
+                if (value.empty() && remainder == 0) break;
+            }
+        }
+        while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+        std::reverse(digits.begin(), digits.end());
+        return digits;
+    }
+
+private:
+    std::vector<uint32_t> limbs;
+};
+
+// saturating arithmetic for counts that only have to be compared or used as tree indices
+inline uint64_t saturatingAdd(uint64_t a, uint64_t b) {
+    return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+inline uint64_t saturatingMultiply(uint64_t a, uint64_t b) {
+    return b && a > UINT64_MAX / b ? UINT64_MAX : a * b;
+}
+
+struct ParseTree {
+    std::string label;
+    std::vector<ParseTree> children;
+
+    // bracketed form, e.g. (S (A a) (B b))
+    std::string toString() const {
+        if (children.empty()) return label;
+        std::string result = "(" + label;
+        for (const auto& child : children) result += " " + child.toString();
+        return result + ")";
+    }
+};
+
+/**
+ * @brief Shared packed parse forest of a finished CYK table
+ * A symbol node (A, i, j) stands for every derivation of input[i..j] from A and
+ * owns one packed node per way to split it : (k, B, C) with A -> B C,
+ * B in cell(i, k) and C in cell(k + 1, j). Children are shared symbol nodes,
+ * so the forest holds at most N n^2 symbol nodes and |G| n^3 packed nodes
+ * however many trees it encodes. Only nodes reachable from the root are built.
+ */
+
+class SPPF {
+public:
+    struct SymbolNode {
+        int non_terminal;
+        int i;
+        int j;
+        int first_packed; // packed nodes first_packed .. first_packed + packed_count - 1
+        int packed_count;
+    };
+
+    struct PackedNode {
+        int split; // -1 for a unit rule A -> a
+        int left;
+        int right;
+    };
+
+    SPPF(const BitCYKTable& table, const CompiledGrammar& grammar, const std::string& input)
+        : grammar(grammar), input(input), n(input.size()) {
+        int nt = grammar.numNonTerminals();
+        rules_by_head.resize(nt);
+        const auto& pairs = grammar.binaryPairs();
+        for (int p = 0; p < pairs.size(); p++) {
+            const Word* head = grammar.headMaskBySlot(p);
+            for (int a = 0; a < nt; a++) {
+                if (testBit(head, a)) rules_by_head[a].push_back(pairs[p]);
+            }
+        }
+        if (bitCYKAccepts(table, grammar)) build(table);
+    }
+
+    bool empty() const {
+        return symbols.empty();
+    }
+
+    int root() const {
+        return 0;
+    }
+
+    const std::vector<SymbolNode>& symbolNodes() const {
+        return symbols;
+    }
+
+    const std::vector<PackedNode>& packedNodes() const {
+        return packed;
+    }
+
+    /**
+     * @brief Number of derivations of every symbol node
+     * children always cover shorter spans, so nodes are visited by increasing span
+     * count(node) = sum over packed nodes of count(left) * count(right), a leaf counts 1
+     *
+     * @tparam Count uint64_t (saturating) or BigCount (exact)
+     * @return std::vector<Count> indexed by symbol node
+     */
+
+    template <class Count>
+    std::vector<Count> countDerivations() const {
+        std::vector<Count> count(symbols.size(), Count(0));
+        std::vector<int> order(symbols.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return symbols[a].j - symbols[a].i < symbols[b].j - symbols[b].i;
+        });
+        for (int node : order) {
+            const SymbolNode& symbol = symbols[node];
+            for (int p = symbol.first_packed; p < symbol.first_packed + symbol.packed_count; p++) {
+                if (packed[p].split < 0) {
+                    add(count[node], Count(1));
+                } else {
+                    add(count[node], multiply(count[packed[p].left], count[packed[p].right]));
+                }
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief The index-th tree of a symbol node, 0 <= index < count(node)
+     * Procedure
+     * 1. Packed nodes are taken in order, each one covers count(left) * count(right) trees
+     * 2. Skip whole packed nodes until the index falls inside one
+     * 3. Split the remaining index into a left index and a right index (mixed radix)
+     * Saturated counts still give distinct valid trees for indices below UINT64_MAX
+     *
+     * @param node
+     * @param index
+     * @param counts from countDerivations<uint64_t>()
+     * @return ParseTree
+     */
+
+    ParseTree unrank(int node, uint64_t index, const std::vector<uint64_t>& counts) const {
+        const SymbolNode& symbol = symbols[node];
+        ParseTree tree{grammar.name(symbol.non_terminal), {}};
+        for (int p = symbol.first_packed; p < symbol.first_packed + symbol.packed_count; p++) {
+            const PackedNode& choice = packed[p];
+            if (choice.split < 0) {
+                if (index == 0) {
+                    tree.children.push_back({std::string(1, input[symbol.i]), {}});
+                    return tree;
+                }
+                index--;
+                continue;
+            }
+            uint64_t left_count = counts[choice.left], right_count = counts[choice.right];
+            uint64_t trees = saturatingMultiply(left_count, right_count);
+            if (index >= trees) {
+                index -= trees;
+                continue;
+            }
+            tree.children.push_back(unrank(choice.left, index / right_count, counts));
+            tree.children.push_back(unrank(choice.right, index % right_count, counts));
+            return tree;
+        }
+        throw std::runtime_error("Tree index out of range");
+    }
+
+    /**
+     * @brief Trees of the whole input one at a time, each is built only when asked for
+     */
+
+    class TreeEnumerator {
+    public:
+        explicit TreeEnumerator(const SPPF& forest) : forest(forest) {
+            if (!forest.empty()) {
+                counts = forest.countDerivations<uint64_t>();
+                total = counts[forest.root()];
+            }
+        }
+
+        std::optional<ParseTree> next() {
+            if (index >= total) return std::nullopt;
+            return forest.unrank(forest.root(), index++, counts);
+        }
+
+    private:
+        const SPPF& forest;
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t index = 0;
+    };
+
+    // the first k trees of the input
+    std::vector<ParseTree> firstTrees(int k) const {
+        std::vector<ParseTree> trees;
+        TreeEnumerator enumerator(*this);
+        while (trees.size() < k) {
+            auto tree = enumerator.next();
+            if (!tree) break;
+            trees.push_back(*tree);
+        }
+        return trees;
+    }
+
+private:
+    const CompiledGrammar& grammar;
+    std::string input;
+    int n;
+    std::vector<std::vector<std::pair<int, int>>> rules_by_head;
+    std::vector<SymbolNode> symbols;
+    std::vector<PackedNode> packed;
+    std::unordered_map<uint64_t, int> symbol_index;
+
+    static void add(uint64_t& a, uint64_t b) { a = saturatingAdd(a, b); }
+    static void add(BigCount& a, const BigCount& b) { a += b; }
+    static uint64_t multiply(uint64_t a, uint64_t b) { return saturatingMultiply(a, b); }
+    static BigCount multiply(const BigCount& a, const BigCount& b) { return a * b; }
+
+    int symbolNode(int non_terminal, int i, int j, std::vector<int>& pending) {
+        uint64_t key = ((uint64_t)non_terminal * n + i) * n + j;
+        auto it = symbol_index.find(key);
+        if (it != symbol_index.end()) return it->second;
+        int id = symbols.size();
+        symbol_index[key] = id;
+        symbols.push_back({non_terminal, i, j, 0, 0});
+        pending.push_back(id);
+        return id;
+    }
+
+    /**
+     * @brief Build the forest top down from (S, 0, n - 1)
+     * every pending symbol node gets its packed nodes, new children become pending
+     */
+
+    void build(const BitCYKTable& table) {
+        std::vector<int> pending;
+        symbolNode(grammar.start, 0, n - 1, pending);
+        while (!pending.empty()) {
+            int node = pending.back();
+            pending.pop_back();
+            int a = symbols[node].non_terminal, i = symbols[node].i, j = symbols[node].j;
+            symbols[node].first_packed = packed.size();
+
+            if (i == j) {
+                const Word* mask = grammar.terminalMask(input[i]);
+                if (mask && testBit(mask, a)) packed.push_back({-1, -1, -1});
+            } else {
+                for (int k = i; k < j; k++) {
+                    for (const auto& [b, c] : rules_by_head[a]) {
+                        if (table.has(i, k, b) && table.has(k + 1, j, c)) {
+                            int left = symbolNode(b, i, k, pending);
+                            int right = symbolNode(c, k + 1, j, pending);
+                            packed.push_back({k, left, right});
+                        }
+                    }
+                }
+            }
+            symbols[node].packed_count = packed.size() - symbols[node].first_packed;
+        }
+    }
+};
+
+/**
+ * @brief Draw one parse tree with graphviz, the leaves are the input symbols
+ *
+ * @param tree
+ * @param filename written as filename.dot and filename.png
+ */
+
+void exportParseTreeDot(const ParseTree& tree, const std::string& filename) {
+    std::ofstream file(filename + ".dot");
+    file << "digraph ParseTree {\n";
+    file << "node [shape=plaintext];\n";
+
+    int count = 0;
+    std::stack<std::pair<const ParseTree*, int>> stack; // node and the id of its parent
+    stack.push({&tree, -1});
+    while (!stack.empty()) {
+        auto [node, parent] = stack.top();
+        stack.pop();
+        int id = count++;
+        file << "n" << id << " [label=\"" << node->label << "\"];\n";
+        if (parent >= 0) file << "n" << parent << " -> n" << id << ";\n";
+        for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+            stack.push({&*it, id});
+        }
+    }
+
+    file << "}\n";
+    file.close();
+    std::string command = "dot -Tpng " + filename + ".dot -o " + filename + ".png";
+    system(command.c_str());
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "bitCYK.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Read only memory mapping of a whole file
+ * The pages are read by the kernel as the tokenizer walks over them, a large
+ * token file is never copied into a string first.
+ */
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Error opening file: " + filename);
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw std::runtime_error("Error reading file: " + filename);
+        }
+        length = info.st_size;
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Error mapping file: " + filename);
+            }
+            address = static_cast<const char*>(mapped);
+            madvise(mapped, length, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (address) munmap(const_cast<char*>(address), length);
+    }
+
+    std::string_view text() const {
+        return std::string_view(address ? address : "", length);
+    }
+
+private:
+    const char* address = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * @brief Whitespace delimited tokens of a text as terminal ids of the grammar
+ * Every token is looked up once in the interned terminals, a token that no
+ * unit rule reads gets -1 and leaves its diagonal cell empty
+ *
+ * @param text
+ * @param grammar
+ * @param spellings if given, receives every token as a view into text
+ * @return std::vector<int> one terminal id per token
+ */
+
+std::vector<int> tokenIds(std::string_view text, const CompiledGrammar& grammar, std::vector<std::string_view>* spellings = nullptr) {
+    std::vector<int> ids;
+    std::string token;
+    size_t i = 0, n = text.size();
+    while (true) {
+        while (i < n && std::isspace((unsigned char)text[i])) i++;
+        if (i == n) break;
+        size_t begin = i;
+        while (i < n && !std::isspace((unsigned char)text[i])) i++;
+        token.assign(text.data() + begin, i - begin);
+        ids.push_back(grammar.terminalId(token));
+        if (spellings) spellings->push_back(text.substr(begin, i - begin));
+    }
+    return ids;
+}
+
+// tokens already cut by a lexer, e.g. token kinds named like the terminals of the grammar
+std::vector<int> tokenIds(const std::vector<std::string>& tokens, const CompiledGrammar& grammar) {
+    std::vector<int> ids;
+    ids.reserve(tokens.size());
+    for (const auto& token : tokens) ids.push_back(grammar.terminalId(token));
+    return ids;
+}
+
+// the first token of the stream that no rule of the grammar reads, -1 if every token is known
+int unknownToken(const std::vector<int>& ids) {
+    for (int i = 0; i < ids.size(); i++) {
+        if (ids[i] < 0) return i;
+    }
+    return -1;
+}
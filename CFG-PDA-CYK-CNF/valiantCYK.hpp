@@ -0,0 +1,210 @@
+#pragma once
+#include "bitCYK.hpp"
+
+/**
+ * @brief Square boolean matrix packed 64 columns per word, row major
+ */
+
+class BitMatrix {
+public:
+    BitMatrix(int n = 0) : n(n), row_words(std::max(1, n / 64)), bits((size_t)n * row_words, 0) {}
+
+    Word* row(int i) {
+        return &bits[(size_t)i * row_words];
+    }
+
+    const Word* row(int i) const {
+        return &bits[(size_t)i * row_words];
+    }
+
+    bool get(int i, int j) const {
+        return testBit(row(i), j);
+    }
+
+    void set(int i, int j) {
+        setBit(row(i), j);
+    }
+
+private:
+    int n;
+    int row_words;
+    std::vector<Word> bits;
+};
+
+/**
+ * @brief dst[c0, c0 + width) |= src[c0, c0 + width) for one row
+ * blocks are aligned powers of two, so a block narrower than a word never straddles two words
+ */
+
+inline void orRowBlock(Word* dst, const Word* src, int c0, int width) {
+    if (width >= 64) {
+        for (int w = c0 >> 6, end = (c0 + width) >> 6; w < end; w++) dst[w] |= src[w];
+    } else {
+        Word mask = (width == 64 ? ~Word(0) : ((Word(1) << width) - 1)) << (c0 & 63);
+        dst[c0 >> 6] |= src[c0 >> 6] & mask;
+    }
+}
+
+/**
+ * @brief P[R, C] |= X[R, D] * Y[D, C] over the boolean semiring
+ * R = [r0, r0 + size), C = [c0, c0 + size), D = [d0, d1)
+ * Procedure
+ * 1. Wide blocks use the method of Four Russians : for every 8 rows of Y inside D
+ *    all 256 unions are tabulated once, then each row of X needs one OR per byte
+ * 2. Narrow blocks OR the row of Y for every set bit of X directly
+ */
+
+void multiplyAdd(BitMatrix& P, const BitMatrix& X, const BitMatrix& Y, int r0, int c0, int size, int d0, int d1) {
+    if (d0 >= d1) return;
+    const int width_words = std::max(1, size / 64);
+
+    if (size >= 256 && (d1 - d0) >= 8) {
+        std::vector<Word> table(256 * width_words);
+        for (int g = d0; g < d1; g += 8) {
+            for (int v = 1; v < 256; v++) {
+                int low = __builtin_ctz(v);
+                const Word* prev = &table[(v & (v - 1)) * width_words];
+                const Word* y = Y.row(g + low) + (c0 >> 6);
+                Word* entry = &table[v * width_words];
+                for (int w = 0; w < width_words; w++) entry[w] = prev[w] | y[w];
+            }
+            for (int r = r0; r < r0 + size; r++) {
+                int byte = (X.row(r)[g >> 6] >> (g & 63)) & 0xFF;
+                if (!byte) continue;
+                const Word* entry = &table[byte * width_words];
+                Word* p = P.row(r) + (c0 >> 6);
+                for (int w = 0; w < width_words; w++) p[w] |= entry[w];
+            }
+        }
+        return;
+    }
+
+    for (int r = r0; r < r0 + size; r++) {
+        const Word* x = X.row(r);
+        Word* p = P.row(r);
+        for (int w = d0 >> 6; w <= (d1 - 1) >> 6; w++) {
+            Word segment = x[w];
+            if (w == d0 >> 6) segment &= ~Word(0) << (d0 & 63);
+            if (w == (d1 - 1) >> 6 && ((d1 - 1) & 63) != 63) segment &= (Word(1) << (((d1 - 1) & 63) + 1)) - 1;
+            for (; segment; segment &= segment - 1) {
+                orRowBlock(p, Y.row(w * 64 + __builtin_ctzll(segment)), c0, size);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sub cubic CYK recognition by boolean matrix multiplication
+ * Valiant's reduction in the divide and conquer form given by Okhotin :
+ * positions 0..n, T_A[i][j] holds when A derives input[i..j-1] and
+ * P_(B,C)[i][j] holds when some split of input[i..j-1] has B then C.
+ * The upper triangle is filled block by block, every block first collects
+ * the products of already finished blocks into P, then recurses into quadrants,
+ * a single cell finally becomes T[i][j] = { A | A -> B C, P_(B,C)[i][j] }.
+ * Work is dominated by |pairs| boolean matrix products, O(|G| n^w) in total.
+ */
+
+class ValiantCYK {
+public:
+    explicit ValiantCYK(const CompiledGrammar& grammar) : grammar(grammar) {}
+
+    bool recognize(const std::string& input) {
+        int n = input.size();
+        if (n == 0) return false;
+        size = 1;
+        while (size < n + 1) size <<= 1;
+
+        T.assign(grammar.numNonTerminals(), BitMatrix(size));
+        P.assign(grammar.binaryPairs().size(), BitMatrix(size));
+        for (int i = 0; i < n; i++) {
+            const Word* mask = grammar.terminalMask(input[i]);
+            if (!mask) continue;
+            for (int a = 0; a < grammar.numNonTerminals(); a++) {
+                if (testBit(mask, a)) T[a].set(i, i + 1);
+            }
+        }
+
+        compute(0, size);
+        return T[grammar.start].get(0, n);
+    }
+
+    // A derives input[i..j] (inclusive, same indexing as the CYK table)
+    bool derives(int non_terminal, int i, int j) const {
+        return T[non_terminal].get(i, j + 1);
+    }
+
+private:
+    const CompiledGrammar& grammar;
+    int size = 0;
+    std::vector<BitMatrix> T;
+    std::vector<BitMatrix> P;
+
+    void compute(int l, int m) {
+        if (m - l >= 4) {
+            compute(l, (l + m) / 2);
+            compute((l + m) / 2, m);
+        }
+        complete(l, (l + m) / 2, (l + m) / 2, m);
+    }
+
+    // P[R, C] |= T[R, D] * T[D, C] for every pair (B, C) of the grammar
+    void product(int r0, int c0, int block, int d0, int d1) {
+        const auto& pairs = grammar.binaryPairs();
+        for (int p = 0; p < pairs.size(); p++) {
+            multiplyAdd(P[p], T[pairs[p].first], T[pairs[p].second], r0, c0, block, d0, d1);
+        }
+    }
+
+    /**
+     * @brief Finish the block of rows [l, m) and columns [l2, m2)
+     * every cell below and left of the block must already be final
+     */
+
+    void complete(int l, int m, int l2, int m2) {
+        if (m - l == 1) {
+            if (m == l2) return; // single symbol, filled from the unit rules
+            const auto& pairs = grammar.binaryPairs();
+            for (int p = 0; p < pairs.size(); p++) {
+                if (!P[p].get(l, l2)) continue;
+                const Word* head = grammar.headMaskBySlot(p);
+                for (int a = 0; a < grammar.numNonTerminals(); a++) {
+                    if (testBit(head, a)) T[a].set(l, l2);
+                }
+            }
+            return;
+        }
+
+        int half = (m - l) / 2;
+        int b = l, b2 = l + half;       // row quadrants B, B'
+        int c = l2, c2 = l2 + half;     // column quadrants C, C'
+
+        product(b2, c, half, m, l2);
+        complete(b2, m, c, c2);
+
+        product(b, c, half, b2, m);
+        complete(b, b2, c, c2);
+
+        product(b2, c2, half, c, c2);
+        complete(b2, m, c2, m2);
+
+        product(b, c2, half, b2, m);
+        product(b, c2, half, m, l2);
+        product(b, c2, half, c, c2);
+        complete(b, b2, c2, m2);
+    }
+};
+
+/**
+ * @brief Drop in recognizer for a grammar read by readCFG
+ *
+ * @param input
+ * @param grammar CNF grammar
+ * @param start_symbol
+ * @return true if the start symbol derives the input
+ */
+
+bool valiantRecognize(const std::string& input, const Grammar& grammar, const std::string& start_symbol) {
+    CompiledGrammar compiled(grammar, start_symbol);
+    ValiantCYK recognizer(compiled);
+    return recognizer.recognize(input);
+}
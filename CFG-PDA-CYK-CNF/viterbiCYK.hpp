@@ -0,0 +1,215 @@
+#pragma once
+#include "sppf.hpp"
+
+/**
+ * @brief Probabilistic CYK, the most probable parse of a weighted CNF grammar
+ * Every cell keeps, per nonterminal A, the best log probability of A deriving
+ * input[i..j] and a back pointer (split, B, C) to the rule that gave it.
+ * Procedure for every span, shortest first
+ * 1. for every split k, every B of cell(i, k) and every C of cell(k + 1, j),
+ *    every rule A -> B C scores log P(rule) + score(B) + score(C), the best one per A is kept
+ * 2. threshold : entries more than threshold below the best entry of the cell are dropped
+ * 3. beam      : only the beam best entries of the cell are kept
+ * The cell of the whole input is never pruned, nothing is built above it.
+ * Cells are sparse lists sorted by nonterminal, so pruning bounds the (B, C) pairs
+ * every split has to try. Without pruning the result is the exact Viterbi parse.
+ */
+
+class ViterbiCYK {
+public:
+    ViterbiCYK(const WeightedGrammar& grammar, const std::string& start_symbol) {
+        std::vector<std::string> order;
+        for (const auto& entry : grammar) order.push_back(entry.first);
+        std::sort(order.begin(), order.end());
+        for (const auto& non_terminal : order) {
+            ids[non_terminal] = names.size();
+            names.push_back(non_terminal);
+        }
+        auto start_it = ids.find(start_symbol);
+        start = start_it == ids.end() ? -1 : start_it->second;
+
+        int n = names.size();
+        pair_slot.assign((size_t)n * n, -1);
+        for (const auto& non_terminal : order) {
+            int a = ids[non_terminal];
+            for (const auto& prod : grammar.at(non_terminal)) {
+                const auto& rhs = prod.symbols;
+                if (rhs.size() == 1 && rhs[0].size() == 1 && !grammar.count(rhs[0])) {
+                    terminal_rules[(unsigned char)rhs[0][0]].push_back({a, prod.log_prob});
+                } else if (rhs.size() == 2 && grammar.count(rhs[0]) && grammar.count(rhs[1])) {
+                    int& slot = pair_slot[(size_t)ids[rhs[0]] * n + ids[rhs[1]]];
+                    if (slot < 0) {
+                        slot = binary_rules.size();
+                        binary_rules.emplace_back();
+                    }
+                    binary_rules[slot].push_back({a, prod.log_prob});
+                } else {
+                    throw std::runtime_error("Viterbi CYK needs a grammar in CNF, " + non_terminal + " has a rule that is not A -> B C or A -> a");
+                }
+            }
+        }
+        best.assign(n, NO_SCORE);
+        back.resize(n);
+    }
+
+    /**
+     * @brief Fill the chart of the input
+     *
+     * @param input
+     * @param beam entries kept per cell, 0 keeps all of them
+     * @param threshold entries kept per cell are at most this far below the best one
+     * @return std::optional<double> log probability of the best parse, empty if none survived
+     */
+
+    std::optional<double> parse(const std::string& input, int beam = 0, double threshold = std::numeric_limits<double>::infinity()) {
+        text = input;
+        int n = input.size();
+        cells.assign((size_t)n * n, {});
+        applied = 0;
+
+        for (int i = 0; i < n; i++) {
+            for (const auto& rule : terminal_rules[(unsigned char)input[i]]) {
+                offer(rule.head, rule.log_prob, {-1, -1, -1});
+            }
+            finishCell(i, i, n == 1 ? 0 : beam, n == 1 ? std::numeric_limits<double>::infinity() : threshold);
+        }
+
+        for (int len = 2; len <= n; len++) {
+            for (int i = 0; i <= n - len; i++) {
+                int j = i + len - 1;
+                for (int k = i; k < j; k++) {
+                    const auto& left = cell(i, k);
+                    const auto& right = cell(k + 1, j);
+                    if (left.empty() || right.empty()) continue;
+                    for (const auto& b : left) {
+                        const int* slots = &pair_slot[(size_t)b.non_terminal * names.size()];
+                        for (const auto& c : right) {
+                            int slot = slots[c.non_terminal];
+                            if (slot < 0) continue;
+                            double children = b.score + c.score;
+                            for (const auto& rule : binary_rules[slot]) {
+                                offer(rule.head, rule.log_prob + children, {k, b.non_terminal, c.non_terminal});
+                                applied++;
+                            }
+                        }
+                    }
+                }
+                finishCell(i, j, len == n ? 0 : beam, len == n ? std::numeric_limits<double>::infinity() : threshold);
+            }
+        }
+
+        const Entry* root = n > 0 && start >= 0 ? find(0, n - 1, start) : nullptr;
+        if (!root) return std::nullopt;
+        return root->score;
+    }
+
+    // the best parse of the last input, empty if parse found none
+    std::optional<ParseTree> bestTree() const {
+        int n = text.size();
+        if (n == 0 || start < 0 || !find(0, n - 1, start)) return std::nullopt;
+        return buildTree(start, 0, n - 1);
+    }
+
+    // log probability of the best derivation of input[i..j] from the nonterminal, empty if pruned or none
+    std::optional<double> score(int i, int j, const std::string& non_terminal) const {
+        auto it = ids.find(non_terminal);
+        if (it == ids.end()) return std::nullopt;
+        const Entry* entry = find(i, j, it->second);
+        if (!entry) return std::nullopt;
+        return entry->score;
+    }
+
+    // binary rule applications of the last parse, the work pruning saves
+    size_t rulesApplied() const {
+        return applied;
+    }
+
+    // entries over every cell of the last parse
+    size_t entries() const {
+        size_t count = 0;
+        for (const auto& entries : cells) count += entries.size();
+        return count;
+    }
+
+private:
+    static constexpr double NO_SCORE = -std::numeric_limits<double>::infinity();
+
+    struct WeightedRule {
+        int head;
+        double log_prob;
+    };
+
+    struct BackPointer {
+        int split; // -1 for a terminal rule
+        int left;
+        int right;
+    };
+
+    struct Entry {
+        int non_terminal;
+        double score;
+        BackPointer back;
+    };
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+    int start;
+    std::vector<WeightedRule> terminal_rules[256];
+    std::vector<int> pair_slot; // (B, C) -> index into binary_rules, -1 if no rule
+    std::vector<std::vector<WeightedRule>> binary_rules;
+
+    std::string text;
+    std::vector<std::vector<Entry>> cells; // cell(i, j) at i * n + j, sorted by nonterminal
+    size_t applied = 0;
+
+    // scratch of the cell being filled, dense over nonterminals
+    std::vector<double> best;
+    std::vector<BackPointer> back;
+    std::vector<int> touched;
+
+    const std::vector<Entry>& cell(int i, int j) const {
+        return cells[(size_t)i * text.size() + j];
+    }
+
+    const Entry* find(int i, int j, int non_terminal) const {
+        const auto& entries = cell(i, j);
+        auto it = std::lower_bound(entries.begin(), entries.end(), non_terminal,
+                                   [](const Entry& entry, int a) { return entry.non_terminal < a; });
+        return it != entries.end() && it->non_terminal == non_terminal ? &*it : nullptr;
+    }
+
+    void offer(int a, double score, BackPointer pointer) {
+        if (score == NO_SCORE) return; // probability 0 (a sum of log probabilities underflowed), no derivation
+        if (best[a] == NO_SCORE) touched.push_back(a);
+        if (score > best[a]) {
+            best[a] = score;
+            back[a] = pointer;
+        }
+    }
+
+    void finishCell(int i, int j, int beam, double threshold) {
+        auto& entries = cells[(size_t)i * text.size() + j];
+        double top = NO_SCORE;
+        for (int a : touched) top = std::max(top, best[a]);
+        for (int a : touched) {
+            if (best[a] >= top - threshold) entries.push_back({a, best[a], back[a]});
+            best[a] = NO_SCORE;
+        }
+        touched.clear();
+        if (beam > 0 && entries.size() > beam) {
+            // ties go to the smaller nonterminal, the kept set does not depend on the order of offers
+            std::nth_element(entries.begin(), entries.begin() + beam, entries.end(), [](const Entry& x, const Entry& y) {
+                return x.score != y.score ? x.score > y.score : x.non_terminal < y.non_terminal;
+            });
+            entries.resize(beam);
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& x, const Entry& y) { return x.non_terminal < y.non_terminal; });
+    }
+
+    ParseTree buildTree(int a, int i, int j) const {
+        const Entry* entry = find(i, j, a);
+        if (entry->back.split < 0) return ParseTree{names[a], {ParseTree{std::string(1, text[i]), {}}}};
+        int k = entry->back.split;
+        return ParseTree{names[a], {buildTree(entry->back.left, i, k), buildTree(entry->back.right, k + 1, j)}};
+    }
+};
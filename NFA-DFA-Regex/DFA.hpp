@@ -1,3 +1,4 @@
+#pragma once
 #include "NFA.hpp"
 class DFA {
 public:
@@ -105,16 +106,33 @@ public:
         if (input.empty()) {
             return accepting_states.find(start_state) != accepting_states.end();
         }
-        std::string current_state = start_state;
+        const State* current_state = &start_state;
         for (const char& symbol : input) {
-            auto it = states.find(current_state);
-            if (it != states.end() && it->second.find(std::string(1, symbol)) != it->second.end()) {
-                current_state = it->second.at(std::string(1, symbol));
-            } else {
-                return false;
-            }
+            current_state = next(*current_state, symbol);
+            if (!current_state) return false;
+        }
+        return accepting_states.find(*current_state) != accepting_states.end();
+    }
+
+    /**
+     * @brief The state reached from state on symbol
+     * A literal edge is found by its one character label, otherwise the class
+     * labels of the state are searched, they never overlap
+     *
+     * @param state
+     * @param symbol
+     * @return const State* nullptr if there is no such transition
+     */
+
+    const State* next(const State& state, char symbol) const {
+        auto it = states.find(state);
+        if (it == states.end()) return nullptr;
+        auto literal = it->second.find(std::string(1, symbol));
+        if (literal != it->second.end()) return &literal->second;
+        for (const auto& [label, next_state] : it->second) {
+            if (label.size() > 1 && labelContains(label, symbol)) return &next_state;
         }
-        return accepting_states.find(current_state) != accepting_states.end();
+        return nullptr;
     }
 
     void csvToDFA(const std::string& filename) {
@@ -163,7 +181,39 @@ public:
 
         setDFA(states, start_state, accepting_states);
     }
-     
+
+    const DFATransitionTable& getStates() const {
+        return states;
+    }
+
+    const State& getStartState() const {
+        return start_state;
+    }
+
+    const StateSet& getAcceptingStates() const {
+        return accepting_states;
+    }
+
+    bool isAccepting(const State& state) const {
+        return accepting_states.find(state) != accepting_states.end();
+    }
+
+    /**
+     * @brief Symbols used on any transition of the DFA
+     *
+     * @return std::set<std::string>
+     */
+
+    std::set<std::string> alphabet() const {
+        std::set<std::string> symbols;
+        for (const auto& [state, transitions] : states) {
+            for (const auto& [symbol, next_state] : transitions) {
+                symbols.insert(symbol);
+            }
+        }
+        return symbols;
+    }
+
 private:
     DFATransitionTable states;
     StateSet accepting_states;  
@@ -239,6 +289,9 @@ private:
 
     /**
      * @brief Convert NFA to DFA
+     * Class labels of the NFA may overlap, e.g. [a-z] and x, so they are split into
+     * disjoint atoms first ([a-w], x, [y-z]) and the DFA moves on atoms. An NFA
+     * without classes has one atom per character and keeps its labels
      * Procedure:
      * 1. Start state of DFA is the epsilon closure of NFA's start state
      * 2. Mark start state as an accepting state if it contains any of the NFA's final states
@@ -263,6 +316,14 @@ private:
         std::map<StateSet, std::string> stateSetToDFAState;
         std::queue<StateSet> unmarkedStates;
 
+        std::set<std::string> labels;
+        for (const auto& [state, transitions] : nfaStates) {
+            for (const auto& [symbol, nextStates] : transitions) {
+                if (symbol != "") labels.insert(symbol);
+            }
+        }
+        std::map<std::string, std::vector<std::string>> atoms = splitLabels(labels);
+
         // Start state of DFA is the epsilon closure of NFA's start state
         StateSet startClosure = epsilonClosure(nfaStates, startState);
         start_state = stateSetToString(startClosure);  // Initialize start_state
@@ -295,7 +356,9 @@ private:
                 if (it != nfaStates.end()) {
                     for (const auto& [symbol, nextStates] : it->second) { 
                         if (symbol != "") {
-                            transitions[symbol].insert(nextStates.begin(), nextStates.end());
+                            for (const auto& atom : atoms.at(symbol)) {
+                                transitions[atom].insert(nextStates.begin(), nextStates.end());
+                            }
                         }
                     }
                 }
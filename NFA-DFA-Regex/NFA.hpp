@@ -1,5 +1,7 @@
+#pragma once
 #include "parseRegX.hpp"
 int state_id = 0;
+size_t repetition_budget = 100000; // most NFA states a single {m,n} may expand to
 
 using State = std::string;
 using StateSet = std::set<State>;
@@ -15,7 +17,7 @@ std::string generateState() {
 class NFA {
 public:
     NFA(const std::shared_ptr<AstNode>& ast) {
-        construct_NFA(ast, starting_state, final_state, states);
+        construct_NFA(ast);
 
     }
 
@@ -95,112 +97,209 @@ private:
     TransitionTable states;
     /**
      * @brief Construct a NFA from an AST
-     * Process the AST recursively and construct the NFA
+     * Process the AST in post order with an explicit stack, every sub NFA is a
+     * (start, final) fragment on a second stack and all of them share the states table,
+     * so building is linear in the size of the NFA and the depth of the AST is unbounded
      * 
      * Procedure
      * 1. If the node is a literal character, create a starting state and a final state
      *   and add a transition from the starting state to the final state with the character
-     * 2. If the node is a plus node, create a sub NFA for the left and right nodes
-     *  and add transitions from the starting state to the left starting state
-     * and from the left final state to the right starting state
-     * and from the right final state to the final state
-     * 3. If the node is a sequence node, create a sub NFA for the left and right nodes
+     * 2. If the node is a plus node, take the sub NFA of the left node
+     *  and add transitions from the starting state to the sub starting state
+     * and from the sub final state back to the starting state and to the final state
+     * 3. If the node is a sequence node, take the sub NFAs of the left and right nodes
      * and add transitions from the left final state to the right starting state
-     * 4. If the node is an or node, create a sub NFA for the left and right nodes
+     * 4. If the node is an or node, take the sub NFAs of the left and right nodes
      * and add transitions from the starting state to the left and right starting states
      * and from the left and right final states to the final state
-     * 5. If the node is a star node, create a sub NFA for the left node
-     * and add transitions from the starting state to the left starting state
-     * and from the left final state to the right starting state
-     * and from the right final state to the final state
+     * 5. If the node is a star node, take the sub NFA of the left node
+     * and add transitions from the starting state to the sub starting state and the final state
+     * and from the sub final state to the starting state and the final state
+     * 6. If the node is a class node, one transition labelled with the whole class
+     * 7. If the node is a question node, the sub NFA plus a transition around it
+     * 8. If the node is a repeat node X{m,n}, m copies of X in sequence, then n - m
+     * optional copies nested as X (X (X)?)? so every skip goes straight to the final
+     * state and the states grow linearly with n. X{m,} ends with one looping copy.
+     * The first copy is built alone, copies beyond repetition_budget NFA states throw
+     * instead of expanding
+     * 9. A group node is its sub NFA, captures only matter to the Pike VM
+     * 10. A code point class node reads the UTF-8 bytes of one of its code points :
+     * one path of byte range edges per sequence of utf8Sequences, built from the last
+     * byte so sequences that end alike share their suffix states
      * 
      * 
-     * @param node 
-     * @param starting_state 
-     * @param final_state 
-     * @param states 
+     * @param ast 
      */
-    
-
 
-    void construct_NFA(const std::shared_ptr<AstNode>& node, State& starting_state, State& final_state, TransitionTable& states) {
-        if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(node)) {
-            starting_state = generateState();
-            final_state = generateState();
-            states[starting_state][std::string(1, literal_node->ch)].insert(final_state);
-            states[final_state][""].clear(); // Empty transition for final state
-            return;
-        }
+    struct Fragment {
+        State starting_state;
+        State final_state;
+    };
 
-        if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(node)) {
-            State sub_starting_state, sub_final_state;
-            TransitionTable sub_states;
-            construct_NFA(plus_node->left, sub_starting_state, sub_final_state, sub_states);
-
-            starting_state = generateState();
-            final_state = generateState();
-            states = sub_states;
-            states[starting_state][""].insert(sub_starting_state);
-            states[sub_final_state][""].insert({starting_state, final_state});
-            states[final_state][""].clear();
-            return;
-        }
+    enum Phase { ENTER, ASSEMBLE, MEASURED };
 
-        if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(node)) {
-            State left_starting_state, left_final_state;
-            State right_starting_state, right_final_state;
-            TransitionTable left_states, right_states;
+    struct Visit {
+        std::shared_ptr<AstNode> node;
+        Phase phase;
+        size_t mark; // states before the first copy of a repeat
+    };
 
-            construct_NFA(seq_node->left, left_starting_state, left_final_state, left_states);
-            construct_NFA(seq_node->right, right_starting_state, right_final_state, right_states);
+    Fragment leafFragment() {
+        Fragment fragment{generateState(), generateState()};
+        states[fragment.starting_state];
+        states[fragment.final_state][""].clear(); // Empty transition for final state
+        return fragment;
+    }
 
-            starting_state = left_starting_state;
-            final_state = right_final_state;
-            states = left_states;
-            for (const auto& state_pair : right_states) {
-                states[state_pair.first] = state_pair.second;
+    Fragment codePointFragment(const CodePointClassAstNode& code_point_node) {
+        Fragment fragment = leafFragment();
+        std::map<std::pair<std::string, State>, State> suffix_states; // (label, target) -> state reading label into target
+        for (const auto& [low, high] : code_point_node.ranges) {
+            for (const auto& sequence : utf8Sequences(low, high)) {
+                State target = fragment.final_state;
+                for (int k = sequence.size() - 1; k > 0; k--) {
+                    std::string label = byteRangeLabel(sequence[k].first, sequence[k].second);
+                    auto [it, added] = suffix_states.insert({{label, target}, State()});
+                    if (added) {
+                        it->second = generateState();
+                        states[it->second][label].insert(target);
+                    }
+                    target = it->second;
+                }
+                states[fragment.starting_state][byteRangeLabel(sequence[0].first, sequence[0].second)].insert(target);
             }
-            states[left_final_state][""].insert(right_starting_state);
-            return;
         }
+        return fragment;
+    }
 
-        if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(node)) {
-            State left_starting_state, left_final_state;
-            State right_starting_state, right_final_state;
-            TransitionTable left_states, right_states;
-
-
-            construct_NFA(or_node->left, left_starting_state, left_final_state, left_states);
-            construct_NFA(or_node->right, right_starting_state, right_final_state, right_states);
+    void construct_NFA(const std::shared_ptr<AstNode>& ast) {
+        std::vector<Visit> visits = {{ast, ENTER, 0}};
+        std::vector<Fragment> fragments;
+        auto popFragment = [&]() {
+            Fragment fragment = fragments.back();
+            fragments.pop_back();
+            return fragment;
+        };
+
+        while (!visits.empty()) {
+            Visit visit = std::move(visits.back());
+            visits.pop_back();
+            const std::shared_ptr<AstNode>& node = visit.node;
+
+            if (visit.phase == ENTER) {
+                if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(node)) {
+                    Fragment fragment = leafFragment();
+                    states[fragment.starting_state][std::string(1, literal_node->ch)].insert(fragment.final_state);
+                    fragments.push_back(fragment);
+                } else if (auto class_node = std::dynamic_pointer_cast<CharClassAstNode>(node)) {
+                    Fragment fragment = leafFragment();
+                    if (class_node->set.any()) states[fragment.starting_state][charSetLabel(class_node->set)].insert(fragment.final_state);
+                    fragments.push_back(fragment);
+                } else if (auto code_point_node = std::dynamic_pointer_cast<CodePointClassAstNode>(node)) {
+                    fragments.push_back(codePointFragment(*code_point_node));
+                } else if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(node)) {
+                    if (group_node->left) {
+                        visits.push_back({group_node->left, ENTER, 0});
+                    } else { // ()
+                        Fragment fragment = leafFragment();
+                        states[fragment.starting_state][""].insert(fragment.final_state);
+                        fragments.push_back(fragment);
+                    }
+                } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(node)) {
+                    int copies = repeat_node->max < 0 ? repeat_node->min + 1 : repeat_node->max;
+                    if (copies == 0) {
+                        Fragment fragment = leafFragment();
+                        states[fragment.starting_state][""].insert(fragment.final_state);
+                        fragments.push_back(fragment);
+                    } else {
+                        visits.push_back({node, MEASURED, states.size()});
+                        visits.push_back({repeat_node->left, ENTER, 0});
+                    }
+                } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(node)) {
+                    visits.push_back({node, ASSEMBLE, 0});
+                    visits.push_back({seq_node->right, ENTER, 0});
+                    visits.push_back({seq_node->left, ENTER, 0});
+                } else if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(node)) {
+                    visits.push_back({node, ASSEMBLE, 0});
+                    visits.push_back({or_node->right, ENTER, 0});
+                    visits.push_back({or_node->left, ENTER, 0});
+                } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(node)) {
+                    visits.push_back({node, ASSEMBLE, 0});
+                    visits.push_back({star_node->left, ENTER, 0});
+                } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(node)) {
+                    visits.push_back({node, ASSEMBLE, 0});
+                    visits.push_back({plus_node->left, ENTER, 0});
+                } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(node)) {
+                    visits.push_back({node, ASSEMBLE, 0});
+                    visits.push_back({question_node->left, ENTER, 0});
+                } else {
+                    throw std::runtime_error("Unknown AST node type");
+                }
+                continue;
+            }
 
-            starting_state = generateState();
-            final_state = generateState();
-            states = left_states;
-            for (const auto& state_pair : right_states) {
-                states[state_pair.first] = state_pair.second;
+            if (visit.phase == MEASURED) { // the first copy of a repeat is built
+                auto repeat_node = std::static_pointer_cast<RepeatAstNode>(node);
+                size_t copies = repeat_node->max < 0 ? repeat_node->min + 1 : repeat_node->max;
+                size_t copy_states = states.size() - visit.mark;
+                if (copy_states * copies > repetition_budget) {
+                    throw std::runtime_error("Repetition " + repeat_node->getLabel() + " needs about " +
+                                             std::to_string(copy_states * copies) + " NFA states, over the budget of " +
+                                             std::to_string(repetition_budget));
+                }
+                visits.push_back({node, ASSEMBLE, 0});
+                for (size_t k = 1; k < copies; k++) visits.push_back({repeat_node->left, ENTER, 0});
+                continue;
             }
-            states[starting_state][""].insert({left_starting_state, right_starting_state});
-            states[left_final_state][""].insert(final_state);
-            states[right_final_state][""].insert(final_state);
-            states[final_state][""].clear();
-            return;
-        }
 
-        if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(node)) {
-            State sub_starting_state, sub_final_state;
-            TransitionTable sub_states;
-            construct_NFA(star_node->left, sub_starting_state, sub_final_state, sub_states);
-
-            starting_state = generateState();
-            final_state = generateState();
-            states = sub_states;
-            states[starting_state][""].insert({sub_starting_state, final_state});
-            states[sub_final_state][""].insert({starting_state, final_state});
-            states[final_state][""].clear();
-            return;
+            if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(node)) {
+                bool unbounded = repeat_node->max < 0;
+                int copies = unbounded ? repeat_node->min + 1 : repeat_node->max;
+                std::vector<Fragment> parts(fragments.end() - copies, fragments.end());
+                fragments.resize(fragments.size() - copies);
+                Fragment fragment = leafFragment();
+                State current = fragment.starting_state; // where the next copy is attached
+                for (int k = 0; k < copies; k++) {
+                    if (k >= repeat_node->min) states[current][""].insert(fragment.final_state); // optional from here on
+                    states[current][""].insert(parts[k].starting_state);
+                    if (unbounded && k == copies - 1) states[parts[k].final_state][""].insert(parts[k].starting_state);
+                    current = parts[k].final_state;
+                }
+                states[current][""].insert(fragment.final_state);
+                fragments.push_back(fragment);
+            } else if (std::dynamic_pointer_cast<SeqAstNode>(node)) {
+                Fragment right = popFragment(), left = popFragment();
+                states[left.final_state][""].insert(right.starting_state);
+                fragments.push_back({left.starting_state, right.final_state});
+            } else if (std::dynamic_pointer_cast<OrAstNode>(node)) {
+                Fragment right = popFragment(), left = popFragment();
+                Fragment fragment = leafFragment();
+                states[fragment.starting_state][""].insert({left.starting_state, right.starting_state});
+                states[left.final_state][""].insert(fragment.final_state);
+                states[right.final_state][""].insert(fragment.final_state);
+                fragments.push_back(fragment);
+            } else if (std::dynamic_pointer_cast<StarAstNode>(node)) {
+                Fragment sub = popFragment();
+                Fragment fragment = leafFragment();
+                states[fragment.starting_state][""].insert({sub.starting_state, fragment.final_state});
+                states[sub.final_state][""].insert({fragment.starting_state, fragment.final_state});
+                fragments.push_back(fragment);
+            } else if (std::dynamic_pointer_cast<PlusAstNode>(node)) {
+                Fragment sub = popFragment();
+                Fragment fragment = leafFragment();
+                states[fragment.starting_state][""].insert(sub.starting_state);
+                states[sub.final_state][""].insert({fragment.starting_state, fragment.final_state});
+                fragments.push_back(fragment);
+            } else if (std::dynamic_pointer_cast<QuestionAstNode>(node)) {
+                Fragment sub = popFragment();
+                Fragment fragment = leafFragment();
+                states[fragment.starting_state][""].insert({sub.starting_state, fragment.final_state});
+                states[sub.final_state][""].insert(fragment.final_state);
+                fragments.push_back(fragment);
+            }
         }
-
-        throw std::runtime_error("Unknown AST node type");
+        starting_state = fragments.back().starting_state;
+        final_state = fragments.back().final_state;
     }
 };
 
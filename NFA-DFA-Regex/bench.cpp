@@ -0,0 +1,643 @@
+#include "combDFA.hpp"
+#include "simplify.hpp"
+#include "pikeVM.hpp"
+#include "prefilter.hpp"
+#include "tokenizer.hpp"
+#include "product.hpp"
+
+// Benchmarks for the regex pipeline
+// g++ -O2 -std=c++17 bench.cpp -o bench && ./bench
+
+double secondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<std::string> randomWords(int count, int min_length, int max_length, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> words;
+    for (int i = 0; i < count; i++) {
+        int length = min_length + rng() % (max_length - min_length + 1);
+        std::string word;
+        for (int j = 0; j < length; j++) word += 'a' + rng() % 26;
+        words.push_back(word);
+    }
+    return words;
+}
+
+DFA buildMinimizedDFA(const std::string& regex) {
+    std::shared_ptr<AstNode> root = ParseRegex(lexer(regex)).parse();
+    NFA nfa(root);
+    DFA dfa(nfa);
+    dfa.minimize();
+    return dfa;
+}
+
+// union of many keywords, the typical large automaton
+std::string keywordUnion(const std::vector<std::string>& words) {
+    std::string regex;
+    for (const auto& word : words) {
+        if (!regex.empty()) regex += "|";
+        regex += word;
+    }
+    return "(" + regex + ")";
+}
+
+template <class Matcher>
+double throughputMBs(const Matcher& matcher, const std::vector<std::string>& inputs, int rounds, size_t& matched) {
+    size_t bytes = 0;
+    matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& input : inputs) {
+            matched += matcher.match(input);
+            bytes += input.size();
+        }
+    }
+    return bytes / secondsSince(start) / 1e6;
+}
+
+/**
+ * @brief Dense table vs comb vector table on growing keyword unions
+ * memory of both layouts, matching throughput and the encoding chooseEncoding picks
+ */
+
+void benchTableEncodings() {
+    std::cout << "== dense vs comb vector tables ==\n";
+    std::cout << "keywords states classes dense_KB comb_KB comb_fill dense_MB/s comb_MB/s chosen\n";
+    for (int count : {10, 50, 200, 500}) {
+        std::vector<std::string> words = randomWords(count, 5, 12, count);
+        DFA dfa = buildMinimizedDFA(keywordUnion(words));
+        CompiledDFA dense(dfa);
+        CombDFA comb(dense);
+
+        // half of the inputs are keywords, the others near misses that die late
+        std::vector<std::string> inputs;
+        for (const auto& word : words) {
+            inputs.push_back(word);
+            inputs.push_back(word.substr(0, word.size() - 1) + "#");
+        }
+        size_t dense_matched, comb_matched;
+        int rounds = 2000000 / inputs.size();
+        double dense_speed = throughputMBs(dense, inputs, rounds, dense_matched);
+        double comb_speed = throughputMBs(comb, inputs, rounds, comb_matched);
+        if (dense_matched != comb_matched) {
+            throw std::runtime_error("dense and comb tables disagree");
+        }
+
+        std::cout << count << " " << dense.numStates() << " " << dense.numClasses() << " "
+                  << dense.memoryBytes() / 1024.0 << " " << comb.memoryBytes() / 1024.0 << " "
+                  << comb.fillRatio() << " " << dense_speed << " " << comb_speed << " "
+                  << (chooseEncoding(dense, comb) == TableEncoding::DENSE ? "dense" : "comb") << "\n";
+    }
+}
+
+/**
+ * @brief Throughput of the same table under different state orders
+ * a skewed (zipf like) keyword corpus is matched with the table as built,
+ * after a breadth first relayout and after a relayout from a profile that
+ * was saved to disk and loaded back
+ */
+
+void benchStateLayout() {
+    std::cout << "== state layout ==\n";
+    std::vector<std::string> words = randomWords(2000, 5, 12, 7);
+    DFA dfa = buildMinimizedDFA(keywordUnion(words));
+    CompiledDFA built(dfa);
+
+    std::mt19937 rng(11);
+    std::vector<double> weights;
+    for (int i = 0; i < words.size(); i++) weights.push_back(1.0 / (i + 1));
+    std::discrete_distribution<int> zipf(weights.begin(), weights.end());
+    std::vector<std::string> corpus;
+    for (int i = 0; i < 200000; i++) corpus.push_back(words[zipf(rng)]);
+
+    DFAProfile profile = built.newProfile();
+    for (int i = 0; i < corpus.size() / 10; i++) built.matchProfiled(corpus[i], profile);
+    built.saveProfile(profile, "bench_profile.txt");
+    DFAProfile loaded = built.loadProfile("bench_profile.txt");
+    std::remove("bench_profile.txt");
+
+    CompiledDFA bfs = built.relayout();
+    CompiledDFA hot = built.relayout(&loaded);
+
+    std::cout << "states " << built.numStates() << ", table " << built.memoryBytes() / 1024 << " KB\n";
+    size_t built_matched, bfs_matched, hot_matched;
+    std::cout << "as built  MB/s " << throughputMBs(built, corpus, 20, built_matched) << "\n";
+    std::cout << "bfs order MB/s " << throughputMBs(bfs, corpus, 20, bfs_matched) << "\n";
+    std::cout << "profiled  MB/s " << throughputMBs(hot, corpus, 20, hot_matched) << "\n";
+    if (built_matched != bfs_matched || built_matched != hot_matched) {
+        throw std::runtime_error("relayout changed the language");
+    }
+}
+
+// what [a-z]{1,n} had to be written as before classes and counting : (a|..|z) | (a|..|z)(a|..|z) | ...
+std::string expandedRepetition(int n) {
+    std::string letter = "(";
+    for (char c = 'a'; c <= 'z'; c++) letter += std::string(c == 'a' ? "" : "|") + c;
+    letter += ")";
+    std::string regex, copies;
+    for (int k = 1; k <= n; k++) {
+        copies += letter;
+        regex += (k > 1 ? "|" : "") + copies;
+    }
+    return "(" + regex + ")";
+}
+
+size_t countNFATransitions(const NFA& nfa) {
+    size_t count = 0;
+    for (const auto& [state, transitions] : nfa.getStates()) {
+        for (const auto& [symbol, next_states] : transitions) count += next_states.size();
+    }
+    return count;
+}
+
+/**
+ * @brief [a-z]{1,n} with a class edge and nested optional copies against the hand
+ * written alternation it replaces : automaton sizes and build time
+ */
+
+void benchCountingCompilation() {
+    std::cout << "== bounded repetition and classes ==\n";
+    std::cout << "n form nfa_states nfa_edges dfa_states build_s\n";
+    for (int n : {4, 8, 16}) {
+        for (bool expanded : {true, false}) {
+            std::string regex = expanded ? expandedRepetition(n) : "[a-z]{1," + std::to_string(n) + "}";
+            size_t nfa_states = 0, nfa_edges = 0, dfa_states = 0;
+            auto start = std::chrono::steady_clock::now();
+            NFA nfa(ParseRegex(lexer(regex)).parse());
+            DFA dfa(nfa);
+            dfa.minimize();
+            double seconds = secondsSince(start);
+            nfa_states = nfa.getStates().size();
+            nfa_edges = countNFATransitions(nfa);
+            dfa_states = dfa.getStates().size();
+            if (dfa.match(std::string(n, 'q')) != true || dfa.match(std::string(n + 1, 'q')) != false) {
+                throw std::runtime_error("repetition matches the wrong lengths");
+            }
+            std::cout << n << " " << (expanded ? "expanded" : "counted") << " " << nfa_states << " " << nfa_edges << " "
+                      << dfa_states << " " << seconds << "\n";
+        }
+    }
+    for (int n : {64, 256}) {
+        auto start = std::chrono::steady_clock::now();
+        NFA nfa(ParseRegex(lexer("[a-z]{1," + std::to_string(n) + "}")).parse());
+        DFA dfa(nfa);
+        dfa.minimize();
+        std::cout << n << " counted " << nfa.getStates().size() << " " << countNFATransitions(nfa) << " "
+                  << dfa.getStates().size() << " " << secondsSince(start) << "\n";
+    }
+    try {
+        NFA nfa(ParseRegex(lexer("([a-z]{1,1000}){1,1000}")).parse());
+    } catch (const std::runtime_error& error) {
+        std::cout << "([a-z]{1,1000}){1,1000} : " << error.what() << "\n";
+    }
+}
+
+/**
+ * @brief Redundant patterns as tools generate them, built as written and after simplifyRegex :
+ * AST nodes, NFA states, DFA states of the subset construction and build time
+ */
+
+void benchSimplification() {
+    std::cout << "== AST simplification ==\n";
+    std::cout << "pattern form ast_nodes nfa_states dfa_states build_s\n";
+    std::vector<std::string> letters;
+    for (char c = 'a'; c <= 'z'; c++) letters.push_back(std::string(1, c));
+    std::vector<std::string> suffixed;
+    for (const auto& word : randomWords(100, 3, 6, 11)) {
+        suffixed.push_back(word + "ing");
+        suffixed.push_back(word + "ed");
+    }
+    std::vector<std::string> repeated = randomWords(50, 4, 8, 13), copies = repeated;
+    repeated.insert(repeated.end(), copies.begin(), copies.end());
+    std::vector<std::pair<std::string, std::string>> patterns = {
+        {"keywords_500", keywordUnion(randomWords(500, 3, 10, 7))},
+        {"suffixes_200", keywordUnion(suffixed)},
+        {"duplicates_100", keywordUnion(repeated)},
+        {"letters", keywordUnion(letters) + "+" + keywordUnion(letters) + "*"},
+        {"nested_closures", "((((a|b)*)+)*)?((c+)+)*(((d?)*)?)+"},
+    };
+    for (const auto& [name, regex] : patterns) {
+        std::shared_ptr<AstNode> root = ParseRegex(lexer(regex)).parse();
+        for (bool simplified : {false, true}) {
+            auto start = std::chrono::steady_clock::now();
+            std::shared_ptr<AstNode> ast = simplified ? simplifyRegex(root) : root;
+            NFA nfa(ast);
+            DFA dfa(nfa);
+            double seconds = secondsSince(start);
+            std::cout << name << " " << (simplified ? "simplified" : "written") << " " << countAstNodes(ast) << " "
+                      << nfa.getStates().size() << " " << dfa.getStates().size() << " " << seconds << "\n";
+        }
+    }
+}
+
+// random regex over literals, escapes and classes that need escaping when written back
+std::string randomRegex(std::mt19937& rng, int depth) {
+    static const std::vector<std::string> atoms = {"a", "b", "[a-c]", ".", "é", "[^a]", "\\n", "\\x00", "\\x7f",
+                                                   "[\\x01-\\x1f]", "\\*", "[\\]\\-^]", "[ -/]", "\\\\", "[α-ω]"};
+    int kind = rng() % (depth > 4 ? 1 : 8);
+    if (kind == 0) return atoms[rng() % atoms.size()];
+    if (kind == 1) return randomRegex(rng, depth + 1) + randomRegex(rng, depth + 1);
+    if (kind == 2) return randomRegex(rng, depth + 1) + "|" + randomRegex(rng, depth + 1);
+    if (kind == 3) return "(" + randomRegex(rng, depth + 1) + ")*";
+    if (kind == 4) return "(" + randomRegex(rng, depth + 1) + ")+";
+    if (kind == 5) return "(" + randomRegex(rng, depth + 1) + ")?";
+    if (kind == 6) return "(" + randomRegex(rng, depth + 1) + "){" + std::to_string(rng() % 3) + "," + std::to_string(2 + rng() % 2) + "}";
+    return "(" + randomRegex(rng, depth + 1) + "|" + randomRegex(rng, depth + 1) + ")";
+}
+
+/**
+ * @brief regexString read back : random regexes are written from their AST and after
+ * simplifyRegex, the text is lexed and parsed again and its minimized DFA must accept
+ * the same language as the original, checked by the two differences of productDFA.
+ * Runs with UTF-8 patterns and with byte patterns
+ */
+
+void benchRegexRoundTrip() {
+    std::cout << "== regexString round trip ==\n";
+    std::cout << "patterns mode written_differ simplified_differ seconds\n";
+    auto equivalent = [](const DFA& a, const DFA& b) {
+        return productDFA(a, b, BoolOp::DIFFERENCE).getAcceptingStates().empty() && productDFA(b, a, BoolOp::DIFFERENCE).getAcceptingStates().empty();
+    };
+    auto minimized = [](const std::shared_ptr<AstNode>& ast) {
+        DFA dfa{NFA(ast)};
+        dfa.minimize();
+        return dfa;
+    };
+    const int count = 1000;
+    for (bool utf8 : {true, false}) {
+        utf8_patterns = utf8;
+        std::mt19937 rng(43);
+        int differ[2] = {0, 0};
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < count; k++) {
+            std::string regex = randomRegex(rng, 0);
+            std::shared_ptr<AstNode> root = ParseRegex(lexer(regex)).parse();
+            DFA original = minimized(root);
+            for (bool simplified : {false, true}) {
+                std::string written = regexString(simplified ? simplifyRegex(root) : root);
+                if (!equivalent(original, minimized(ParseRegex(lexer(written)).parse()))) {
+                    if (differ[simplified]++ == 0) std::cout << "differs : " << regex << " written as " << written << "\n";
+                }
+            }
+        }
+        std::cout << count << " " << (utf8 ? "utf8" : "bytes") << " " << differ[0] << " " << differ[1] << " " << secondsSince(start) << "\n";
+    }
+    utf8_patterns = true;
+}
+
+/**
+ * @brief Submatch extraction : Pike VM against backtracking std::regex
+ * MB/s of a search with captures on random text, then (a*)*b on a^n where
+ * backtracking is exponential and the Pike VM stays linear
+ */
+
+void benchPikeVM() {
+    std::cout << "== Pike VM captures ==\n";
+    std::cout << "pattern bytes pike_MB/s std_regex_MB/s same_spans\n";
+    std::mt19937 rng(17);
+    std::string text;
+    for (int i = 0; i < (1 << 20); i++) text += "abcdefgh @."[rng() % 11];
+    std::vector<std::string> patterns = {"([a-h]+)@([a-h]+)\\.([a-h][a-h]+)", "(a|b)*c(d+)", "(ab|cd|ef)(gh)?"};
+    for (const auto& regex : patterns) {
+        PikeVM vm(ParseRegex(lexer(regex)).parse());
+        std::regex reference(regex);
+        for (size_t length : {size_t(4096), text.size()}) {
+            std::string_view input(text.data(), length);
+            std::vector<std::pair<int, int>> pike_spans, std_spans;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t at = 0; at < length;) {
+                auto found = vm.search(input.substr(at));
+                if (!found) break;
+                pike_spans.push_back({found->span().first + at, found->span().second + at});
+                at += std::max(found->span().second, found->span().first + 1);
+            }
+            double pike = length / secondsSince(start) / 1e6;
+            start = std::chrono::steady_clock::now();
+            std::string owned(input);
+            for (auto it = std::sregex_iterator(owned.begin(), owned.end(), reference); it != std::sregex_iterator(); ++it) {
+                std_spans.push_back({(int)it->position(0), (int)(it->position(0) + it->length(0))});
+            }
+            double backtracking = length / secondsSince(start) / 1e6;
+            std::cout << regex << " " << length << " " << pike << " " << backtracking << " " << (pike_spans == std_spans ? "yes" : "no") << "\n";
+        }
+    }
+
+    std::cout << "pattern n pike_s std_regex_s\n";
+    PikeVM vm(ParseRegex(lexer("(a*)*b")).parse());
+    std::regex reference("(a*)*b");
+    for (int n : {8, 12, 14, 1000, 100000, 1000000}) {
+        std::string input(n, 'a');
+        auto start = std::chrono::steady_clock::now();
+        bool pike_found = vm.search(input).has_value();
+        double pike = secondsSince(start);
+        std::cout << "(a*)*b " << n << " " << pike << " ";
+        if (n <= 14) { // backtracking is exponential here, n = 18 already takes a minute
+            start = std::chrono::steady_clock::now();
+            bool std_found = std::regex_search(input, reference);
+            std::cout << secondsSince(start) << (std_found == pike_found ? "" : " (differs)") << "\n";
+        } else {
+            std::cout << "-\n";
+        }
+    }
+}
+
+/**
+ * @brief UTF-8 classes compiled to byte automata : NFA states of the class fragment
+ * with shared suffixes against one path per byte sequence, minimized DFA states,
+ * and MB/s of the compiled DFA on UTF-8 text, no decoding while matching
+ */
+
+void benchUtf8() {
+    std::cout << "== UTF-8 classes ==\n";
+    std::cout << "pattern sequences path_states nfa_states dfa_states MB/s\n";
+    std::vector<std::string> alphabet = {"a", "z", " ", "é", "ß", "α", "ω", "€", "中", "😀"};
+    std::mt19937 rng(19);
+    for (std::string regex : {"[α-ω]", "[^a]", ".", "[a-zé€中-鿿]", "[^\\n]", "[😀-🙏]"}) {
+        std::shared_ptr<AstNode> class_node = ParseRegex(lexer(regex)).parse();
+        size_t sequences = 0, path_states = 2;
+        if (auto code_points = std::dynamic_pointer_cast<CodePointClassAstNode>(class_node)) {
+            for (const auto& [low, high] : code_points->ranges) {
+                for (const auto& sequence : utf8Sequences(low, high)) {
+                    sequences++;
+                    path_states += sequence.size() - 1;
+                }
+            }
+        }
+        NFA fragment(class_node);
+        DFA dfa = buildMinimizedDFA("(" + regex + ")*");
+        CompiledDFA compiled(dfa);
+        std::vector<std::string> members; // the input stays in the class, the DFA reads every byte
+        for (const auto& symbol : alphabet) {
+            if (dfa.match(symbol)) members.push_back(symbol);
+        }
+        std::vector<std::string> inputs(64);
+        for (auto& input : inputs) {
+            for (int i = 0; i < 16384; i++) input += members[rng() % members.size()];
+        }
+        size_t matched;
+        double mbs = throughputMBs(compiled, inputs, 4, matched);
+        std::cout << regex << " " << sequences << " " << path_states << " " << fragment.getStates().size() << " "
+                  << dfa.getStates().size() << " " << mbs << "\n";
+    }
+}
+
+/**
+ * @brief Machine generated patterns : a long concatenation, deep nesting, a wide
+ * alternation and a long chain of stars through every stage of draw.cpp : parsed,
+ * simplified and written back, analyzed for the prefilter, compiled for the Pike VM,
+ * built into an NFA and freed. Every stage must stay linear, with no recursion that
+ * a deep AST could overflow
+ */
+
+void benchLargePatterns() {
+    std::cout << "== large generated patterns ==\n";
+    std::cout << "pattern tokens parse_s simplify_s prefilter_s pike_s nfa_states nfa_s free_s\n";
+    for (int n : {10000, 100000, 1000000}) {
+        std::vector<std::pair<std::string, std::string>> patterns(4);
+        patterns[0].first = "concatenation";
+        for (int i = 0; i < n; i++) patterns[0].second += "abc"[i % 3];
+        patterns[1] = {"nesting", std::string(n, '(') + "a" + std::string(n, ')')};
+        patterns[2].first = "alternation";
+        for (int i = 0; i < n; i++) patterns[2].second += std::string(i ? "|" : "") + "abc"[i % 3];
+        patterns[3] = {"stars", "a" + std::string(n, '*')};
+        for (const auto& [name, regex] : patterns) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Token> tokens = lexer(regex);
+            std::shared_ptr<AstNode> root = ParseRegex(tokens).parse();
+            double parse = secondsSince(start);
+            start = std::chrono::steady_clock::now();
+            std::shared_ptr<AstNode> simplified = simplifyRegex(root);
+            regexString(simplified);
+            double simplify = secondsSince(start);
+            start = std::chrono::steady_clock::now();
+            Prefilter prefilter(root);
+            double literals = secondsSince(start);
+            start = std::chrono::steady_clock::now();
+            double pike;
+            {
+                PikeVM vm(root);
+                pike = secondsSince(start);
+            }
+            start = std::chrono::steady_clock::now();
+            size_t nfa_states;
+            double build;
+            {
+                NFA nfa(root);
+                nfa_states = nfa.getStates().size();
+                build = secondsSince(start);
+                start = std::chrono::steady_clock::now();
+                root.reset();
+                simplified.reset();
+            }
+            std::cout << name << " " << tokens.size() << " " << parse << " " << simplify << " " << literals << " " << pike << " "
+                      << nfa_states << " " << build << " " << secondsSince(start) << "\n";
+        }
+    }
+}
+
+/**
+ * @brief Tokenizer throughput on generated C like source
+ * the combined DFA through the buffer and the stream API (a callback, no token vector),
+ * against trying the minimized DFA of every rule at each token start, and a worst case
+ * for backtracking (rules a and a*b on a run of a) that stays linear
+ */
+
+void benchTokenizer() {
+    std::cout << "== maximal munch tokenizer ==\n";
+    std::vector<TokenRule> rules = {
+        {"keyword", "if|else|while|for|return|int|char|void"},
+        {"identifier", "[a-zA-Z_][a-zA-Z_0-9]*"},
+        {"number", "[0-9]+(\\.[0-9]+)?"},
+        {"string", "\"[^\"\n]*\""},
+        {"comment", "//[^\n]*"},
+        {"operator", "==|!=|<=|>=|&&|\\|\\||[-+*/%=<>!&;,.]|\\(|\\)|\\{|\\}|\\[|\\]"},
+        {"space", "[ \t\n]+"},
+    };
+    auto start = std::chrono::steady_clock::now();
+    Tokenizer tokenizer(rules);
+    std::cout << "rules " << rules.size() << " states " << tokenizer.numStates() << " classes " << tokenizer.numClasses()
+              << " build_s " << secondsSince(start) << "\n";
+
+    std::vector<std::string> pieces = {"int ", "while (", "count", " += ", "42", "3.14", "\"text\"", ";\n", "x1 <= y2",
+                                       "return ", "// note\n", "{\n", "}\n", "a[i] && b", "    "};
+    std::mt19937 rng(50);
+    std::string source;
+    while (source.size() < (16 << 20)) source += pieces[rng() % pieces.size()];
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Lexeme> tokens = tokenizer.tokenize(source);
+    double buffer_speed = source.size() / secondsSince(start) / 1e6;
+
+    std::istringstream stream(source);
+    size_t streamed = 0;
+    start = std::chrono::steady_clock::now();
+    tokenizer.tokenize(stream, [&](const Lexeme&) { streamed++; });
+    double stream_speed = source.size() / secondsSince(start) / 1e6;
+
+    std::vector<CompiledDFA> per_rule;
+    for (const auto& rule : rules) per_rule.push_back(CompiledDFA(buildMinimizedDFA(rule.regex)));
+    std::vector<Lexeme> tried;
+    start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < source.size();) {
+        int best = Tokenizer::NO_RULE;
+        size_t best_length = 0;
+        for (int r = 0; r < per_rule.size(); r++) {
+            int state = per_rule[r].startState();
+            for (size_t i = pos; i < source.size(); i++) {
+                state = per_rule[r].next(state, per_rule[r].byteClass(source[i]));
+                if (per_rule[r].stateFlags(state) & CompiledDFA::DEAD) break;
+                if ((per_rule[r].stateFlags(state) & CompiledDFA::ACCEPTING) && i + 1 - pos > best_length) {
+                    best = r;
+                    best_length = i + 1 - pos;
+                }
+            }
+        }
+        if (best == Tokenizer::NO_RULE) best_length = 1;
+        tried.push_back(Lexeme{best, pos, best_length});
+        pos += best_length;
+    }
+    double per_rule_speed = source.size() / secondsSince(start) / 1e6;
+    bool same = tried.size() == tokens.size() && streamed == tokens.size();
+    for (size_t i = 0; same && i < tokens.size(); i++) {
+        same = tried[i].kind == tokens[i].kind && tried[i].length == tokens[i].length;
+    }
+    if (!same) {
+        throw std::runtime_error("tokenizers disagree");
+    }
+    std::cout << "input_MB tokens buffer_MB/s stream_MB/s per_rule_MB/s\n";
+    std::cout << source.size() / 1e6 << " " << tokens.size() << " " << buffer_speed << " " << stream_speed << " "
+              << per_rule_speed << "\n";
+
+    Tokenizer backtracking(std::vector<TokenRule>{{"a", "a"}, {"ab", "a*b"}});
+    std::cout << "backtracking_n seconds\n";
+    for (int n : {100000, 1000000, 10000000}) {
+        std::string input(n, 'a');
+        start = std::chrono::steady_clock::now();
+        backtracking.tokenize(input);
+        std::cout << n << " " << secondsSince(start) << "\n";
+    }
+}
+
+/**
+ * @brief Rule combination A and B and not C decided in one pass by the lazy product,
+ * against running the three minimized DFAs one after the other and against the eager
+ * product built from productDFA and complementDFA, all three must agree on every word.
+ * In the first rule most words fail A on their first bytes, there the lazy product
+ * stops at its dead state while A and B and C still have to read the whole word
+ */
+
+void benchLazyProduct() {
+    std::cout << "== lazy product A & B & !C ==\n";
+    std::cout << "A B C words matched three_dfa_MB/s lazy_MB/s lazy_states eager_MB/s eager_states agree\n";
+    std::vector<std::array<std::string, 3>> rules = {
+        {"(ab|cd)[a-z]*", "[a-z]*e[a-z]*", "[a-z]*(zz|qq)[a-z]*"},
+        {"[a-z]*(ab|ba)[a-z]*", "[a-z]*c[a-z]*", "[a-z]*(zz|qq)[a-z]*"},
+    };
+    std::mt19937 rng(29);
+    std::vector<std::string> words = randomWords(20000, 8, 64, 29);
+    // plant a prefix of A in some words so that every combination occurs
+    for (auto& word : words) {
+        if (rng() % 4 == 0) word.replace(0, 2, rng() % 2 ? "ab" : "cd");
+    }
+    size_t bytes = 0;
+    for (const auto& word : words) bytes += word.size();
+
+    for (const auto& [a_regex, b_regex, c_regex] : rules) {
+        DFA a = buildMinimizedDFA(a_regex), b = buildMinimizedDFA(b_regex), c = buildMinimizedDFA(c_regex);
+        std::vector<bool> separate, lazy, eager;
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& word : words) separate.push_back(a.match(word) && b.match(word) && !c.match(word));
+        double separate_mbs = bytes / secondsSince(start) / 1e6;
+
+        LazyProductDFA product({&a, &b, &c}, [](const std::vector<bool>& m) { return m[0] && m[1] && !m[2]; });
+        start = std::chrono::steady_clock::now();
+        for (const auto& word : words) lazy.push_back(product.match(word));
+        double lazy_mbs = bytes / secondsSince(start) / 1e6;
+
+        DFA eager_product = productDFA(productDFA(a, b, BoolOp::INTERSECTION), complementDFA(c, {"[a-z]"}), BoolOp::INTERSECTION);
+        start = std::chrono::steady_clock::now();
+        for (const auto& word : words) eager.push_back(eager_product.match(word));
+        double eager_mbs = bytes / secondsSince(start) / 1e6;
+
+        std::cout << a_regex << " " << b_regex << " " << c_regex << " " << words.size() << " "
+                  << std::count(separate.begin(), separate.end(), true) << " " << separate_mbs << " "
+                  << lazy_mbs << " " << product.exploredStates() << " " << eager_mbs << " "
+                  << eager_product.getStates().size() << " " << (separate == lazy && separate == eager ? "yes" : "no") << "\n";
+    }
+}
+
+/**
+ * @brief Required literal prefilter on a corpus of log lines, one prefilter per pattern
+ * for the whole corpus. Whole line matches with the minimized DFA and leftmost searches
+ * with the Pike VM, each with and without the prefilter in front, the answers must agree.
+ * The literals of the last pattern are short and common, so fewer lines are skipped
+ */
+
+void benchPrefilter() {
+    std::cout << "== required literal prefilter ==\n";
+    std::cout << "mode pattern lines checked rejected plain_s prefiltered_s same\n";
+    std::mt19937 rng(31);
+    std::vector<std::string> words = randomWords(200, 3, 9, 31);
+    std::vector<std::string> levels = {"info", "debug", "warn", "error"};
+    std::vector<std::string> lines;
+    for (int i = 0; i < 20000; i++) {
+        std::string line = levels[rng() % levels.size()] + ":";
+        int count = 4 + rng() % 12;
+        for (int w = 0; w < count; w++) line += " " + words[rng() % words.size()];
+        if (rng() % 10 == 0) line += " failed after " + std::to_string(rng() % 1000) + "ms";
+        lines.push_back(line);
+    }
+    std::vector<std::string> patterns = {"error:[a-z ]* failed after [0-9]+ms", "[a-z]+: [a-z ]*timeout[a-z ]*", "[a-z]+:[a-z ]*[0-9]+ms"};
+
+    for (const auto& regex : patterns) {
+        std::shared_ptr<AstNode> root = ParseRegex(lexer(regex)).parse();
+        DFA dfa = buildMinimizedDFA(regex);
+        PrefilteredDFA filtered_dfa(dfa, root);
+        std::vector<bool> plain_match, filtered_match;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& line : lines) plain_match.push_back(dfa.match(line));
+        double plain = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        for (const auto& line : lines) filtered_match.push_back(filtered_dfa.match(line));
+        double filtered = secondsSince(start);
+        const Prefilter& match_filter = filtered_dfa.getPrefilter();
+        std::cout << "match " << regex << " " << lines.size() << " " << match_filter.checkedCount() << " " << match_filter.rejectedCount()
+                  << " " << plain << " " << filtered << " " << (plain_match == filtered_match ? "yes" : "no") << "\n";
+
+        PikeVM vm(root);
+        PrefilteredPikeVM filtered_vm(root);
+        std::vector<std::pair<int, int>> plain_spans, filtered_spans;
+        start = std::chrono::steady_clock::now();
+        for (const auto& line : lines) {
+            auto found = vm.search(line);
+            plain_spans.push_back(found ? found->span() : std::make_pair(-1, -1));
+        }
+        plain = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        for (const auto& line : lines) {
+            auto found = filtered_vm.search(line);
+            filtered_spans.push_back(found ? found->span() : std::make_pair(-1, -1));
+        }
+        filtered = secondsSince(start);
+        const Prefilter& search_filter = filtered_vm.getPrefilter();
+        std::cout << "search " << regex << " " << lines.size() << " " << search_filter.checkedCount() << " " << search_filter.rejectedCount()
+                  << " " << plain << " " << filtered << " " << (plain_spans == filtered_spans ? "yes" : "no") << "\n";
+    }
+}
+
+int main() {
+    benchTableEncodings();
+    benchStateLayout();
+    benchCountingCompilation();
+    benchSimplification();
+    benchRegexRoundTrip();
+    benchPikeVM();
+    benchUtf8();
+    benchLargePatterns();
+    benchTokenizer();
+    benchPrefilter();
+    benchLazyProduct();
+    return 0;
+}
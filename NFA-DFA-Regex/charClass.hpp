@@ -0,0 +1,127 @@
+#pragma once
+#include<bits/stdc++.h>
+
+// A set of bytes, what one class edge of the automata reads
+using CharSet = std::bitset<256>;
+
+// what '.' matches, every byte but the newline
+CharSet anyButNewline() {
+    CharSet set;
+    set.set();
+    set.reset('\n');
+    return set;
+}
+
+/**
+ * @brief Edge label of a set of bytes
+ * A single byte is the one character string, as literal edges always were.
+ * A larger set is '[' followed by a (low, high) byte pair per maximal range and ']',
+ * so a label has one character exactly when it reads one character, and a class
+ * of any size stays one edge of the NFA
+ *
+ * @param set
+ * @return std::string
+ */
+
+std::string charSetLabel(const CharSet& set) {
+    if (set.count() == 1) {
+        for (int c = 0; c < 256; c++) {
+            if (set[c]) return std::string(1, char(c));
+        }
+    }
+    std::string label = "[";
+    for (int c = 0; c < 256; c++) {
+        if (!set[c]) continue;
+        int high = c;
+        while (high + 1 < 256 && set[high + 1]) high++;
+        label += char(c);
+        label += char(high);
+        c = high;
+    }
+    return label + "]";
+}
+
+CharSet labelCharSet(const std::string& label) {
+    CharSet set;
+    if (label.size() == 1) {
+        set.set((unsigned char)label[0]);
+        return set;
+    }
+    for (size_t i = 1; i + 1 < label.size(); i += 2) {
+        for (int c = (unsigned char)label[i]; c <= (unsigned char)label[i + 1]; c++) set.set(c);
+    }
+    return set;
+}
+
+bool labelContains(const std::string& label, char symbol) {
+    if (label.size() == 1) return label[0] == symbol;
+    unsigned char c = symbol;
+    for (size_t i = 1; i + 1 < label.size(); i += 2) {
+        if ((unsigned char)label[i] <= c && c <= (unsigned char)label[i + 1]) return true;
+    }
+    return false;
+}
+
+// a byte of the label, enough to follow the label when labels do not overlap
+char labelRepresentative(const std::string& label) {
+    return label.size() == 1 ? label[0] : label[1];
+}
+
+// a byte as a member of a bracket class
+std::string printableByte(unsigned char c) {
+    if (std::isprint(c) && c != '\\' && c != '-' && c != ']' && c != '^') return std::string(1, char(c));
+    if (c == '\\' || c == '-' || c == ']' || c == '^') return "\\" + std::string(1, char(c));
+    char escaped[8];
+    std::snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+    return std::string(escaped);
+}
+
+// the label as a regex would write it, e.g. [a-z0-9] or . , for drawings and tables
+std::string printableLabel(const std::string& label) {
+    if (label.size() < 2 || label.front() != '[' || label.back() != ']' || label.size() % 2) return label;
+    CharSet set = labelCharSet(label);
+    if (set == anyButNewline()) return ".";
+    std::string text = "[";
+    for (size_t i = 1; i + 1 < label.size(); i += 2) {
+        text += printableByte(label[i]);
+        if (label[i] != label[i + 1]) text += "-" + printableByte(label[i + 1]);
+    }
+    return text + "]";
+}
+
+/**
+ * @brief Split possibly overlapping labels into disjoint atoms
+ * Bytes that belong to exactly the same labels form one atom, every label is the
+ * union of its atoms. Single character labels are their own atom, so automata
+ * without classes keep exactly the labels they had
+ *
+ * @param labels
+ * @return std::map<std::string, std::vector<std::string>> label -> labels of its atoms
+ */
+
+std::map<std::string, std::vector<std::string>> splitLabels(const std::set<std::string>& labels) {
+    std::vector<std::string> ordered(labels.begin(), labels.end());
+    std::vector<std::vector<int>> member_of(256);
+    for (int l = 0; l < ordered.size(); l++) {
+        if (ordered[l].size() == 1) {
+            member_of[(unsigned char)ordered[l][0]].push_back(l);
+            continue;
+        }
+        CharSet set = labelCharSet(ordered[l]);
+        for (int c = 0; c < 256; c++) {
+            if (set[c]) member_of[c].push_back(l);
+        }
+    }
+
+    std::map<std::vector<int>, CharSet> atoms;
+    for (int c = 0; c < 256; c++) {
+        if (!member_of[c].empty()) atoms[member_of[c]].set(c);
+    }
+    std::map<std::string, std::vector<std::string>> split;
+    for (const auto& label : ordered) split[label];
+    for (const auto& [members, set] : atoms) {
+        std::string atom = charSetLabel(set);
+        for (int l : members) split[ordered[l]].push_back(atom);
+    }
+    return split;
+}
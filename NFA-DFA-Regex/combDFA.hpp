@@ -0,0 +1,165 @@
+#pragma once
+#include "compiledDFA.hpp"
+
+/**
+ * @brief Row displacement (comb vector) encoding of a CompiledDFA
+ * Same layout idea as flex's base/next/check/default arrays :
+ * every state keeps a default target, the transitions that differ from it
+ * are stored in the shared next/check arrays starting at base[state].
+ * Rows are overlapped like the teeth of two combs so the mostly default
+ * table of a large automaton collapses into a few dense arrays.
+ *
+ * lookup(s, c) = check[base[s] + c] == s ? next[base[s] + c] : def[s]
+ */
+
+class CombDFA {
+public:
+    explicit CombDFA(const CompiledDFA& dfa) : num_classes(dfa.numClasses()), start_state(dfa.startState()) {
+        for (int byte = 0; byte < 256; byte++) {
+            byte_class[byte] = dfa.byteClass(byte);
+        }
+        int n = dfa.numStates();
+        flags.resize(n);
+        for (int s = 0; s < n; s++) {
+            flags[s] = dfa.stateFlags(s);
+        }
+        pack(dfa);
+    }
+
+    /**
+     * @brief Match the whole input, same early exit rules as CompiledDFA::match
+     *
+     * @param input
+     * @return true
+     * @return false
+     */
+
+    bool match(const std::string& input) const {
+        int state = start_state;
+        if (flags[state] & CompiledDFA::DECIDED) return flags[state] & CompiledDFA::ACCEPTING;
+        for (const char& symbol : input) {
+            state = next(state, byte_class[(unsigned char)symbol]);
+            if (flags[state] & CompiledDFA::DECIDED) return flags[state] & CompiledDFA::ACCEPTING;
+        }
+        return flags[state] & CompiledDFA::ACCEPTING;
+    }
+
+    int next(int state, int cls) const {
+        int index = base[state] + cls;
+        return check[index] == state ? next_state[index] : def[state];
+    }
+
+    // bytes used by the comb arrays
+    size_t memoryBytes() const {
+        return (base.size() + def.size() + next_state.size() + check.size()) * sizeof(int32_t)
+            + flags.size() + byte_class.size();
+    }
+
+    // slots of next/check actually holding a transition
+    double fillRatio() const {
+        size_t used = 0;
+        for (int32_t owner : check) used += owner >= 0;
+        return check.empty() ? 1.0 : (double)used / check.size();
+    }
+
+private:
+    int num_classes;
+    int start_state;
+    std::array<uint8_t, 256> byte_class{};
+    std::vector<uint8_t> flags;
+    std::vector<int32_t> base;
+    std::vector<int32_t> def;
+    std::vector<int32_t> next_state;
+    std::vector<int32_t> check;
+
+    /**
+     * @brief Pack the rows into next/check
+     * Procedure
+     * 1. The default of a row is its most frequent target
+     * 2. Rows are placed from the fullest to the emptiest
+     * 3. Each row takes the lowest base where all its non default columns are free
+     */
+
+    void pack(const CompiledDFA& dfa) {
+        int n = dfa.numStates();
+        base.assign(n, 0);
+        def.assign(n, dfa.deadState());
+
+        std::vector<std::vector<int>> entries(n); // non default columns of each row
+        for (int s = 0; s < n; s++) {
+            std::unordered_map<int, int> frequency;
+            for (int c = 0; c < num_classes; c++) frequency[dfa.next(s, c)]++;
+            int best = -1;
+            for (const auto& [target, count] : frequency) {
+                if (best < 0 || count > frequency[best] || (count == frequency[best] && target < best)) best = target;
+            }
+            def[s] = best;
+            for (int c = 0; c < num_classes; c++) {
+                if (dfa.next(s, c) != best) entries[s].push_back(c);
+            }
+        }
+
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return entries[a].size() > entries[b].size();
+        });
+
+        // lowest base that may still have room, rows only ever move it forward
+        int first_free = 0;
+        for (int s : order) {
+            if (entries[s].empty()) continue;
+            while (first_free < check.size() && check[first_free] >= 0) first_free++;
+
+            int b = std::max(0, first_free - entries[s].front());
+            while (true) {
+                bool fits = true;
+                for (int c : entries[s]) {
+                    if (b + c < check.size() && check[b + c] >= 0) {
+                        fits = false;
+                        break;
+                    }
+                }
+                if (fits) break;
+                b++;
+            }
+
+            base[s] = b;
+            if (check.size() < b + num_classes) {
+                check.resize(b + num_classes, -1);
+                next_state.resize(b + num_classes, 0);
+            }
+            for (int c : entries[s]) {
+                check[b + c] = s;
+                next_state[b + c] = dfa.next(s, c);
+            }
+        }
+
+        // every lookup base[s] + c must stay inside the arrays
+        int size = num_classes;
+        for (int s = 0; s < n; s++) size = std::max(size, base[s] + num_classes);
+        check.resize(size, -1);
+        next_state.resize(size, 0);
+    }
+};
+
+enum class TableEncoding {
+    DENSE,
+    COMB
+};
+
+/**
+ * @brief Pick the table layout for a compiled pattern
+ * The dense table needs one load per byte and wins while it stays in cache,
+ * past the budget the smaller of the two encodings is used
+ *
+ * @param dense
+ * @param comb
+ * @param cache_budget bytes the table may take and still count as cache resident
+ * @return TableEncoding
+ */
+
+TableEncoding chooseEncoding(const CompiledDFA& dense, const CombDFA& comb, size_t cache_budget = 256 * 1024) {
+    if (dense.memoryBytes() <= cache_budget) return TableEncoding::DENSE;
+    return comb.memoryBytes() < dense.memoryBytes() ? TableEncoding::COMB : TableEncoding::DENSE;
+}
@@ -0,0 +1,476 @@
+#pragma once
+#include "DFA.hpp"
+
+/**
+ * @brief Visit counts collected while matching a sample corpus
+ * state_visits[s] counts entries into state s,
+ * transition_counts[s * classes + c] counts the transitions taken out of s on byte class c
+ */
+
+struct DFAProfile {
+    std::vector<uint64_t> state_visits;
+    std::vector<uint64_t> transition_counts;
+};
+
+/**
+ * @brief DFA renumbered into an integer transition table
+ * Bytes that behave the same in every state share one column (byte class),
+ * missing transitions go to an explicit dead state and every state carries
+ * flags from a reachability analysis so matching can stop early
+ */
+
+class CompiledDFA {
+public:
+    static constexpr uint8_t ACCEPTING = 1;
+    static constexpr uint8_t DEAD = 2;           // no accepting state is reachable
+    static constexpr uint8_t ACCEPT_FOREVER = 4; // every continuation is accepted
+    static constexpr uint8_t DECIDED = DEAD | ACCEPT_FOREVER;
+
+    CompiledDFA() = default;
+
+    explicit CompiledDFA(const DFA& dfa) {
+        numberStates(dfa);
+        buildTable(dfa);
+        classifyStates();
+    }
+
+    /**
+     * @brief Match the whole input
+     * Procedure
+     * 1. Start from the start state
+     * 2. For each byte move through the column of its byte class
+     * 3. Stop as soon as a dead or accept forever state is entered,
+     *    the rest of the input can not change the answer
+     * 4. Otherwise the answer is the accepting flag of the last state
+     *
+     * @param input
+     * @return true
+     * @return false
+     */
+
+    bool match(const std::string& input) const {
+        int state = start_state;
+        if (flags[state] & DECIDED) return flags[state] & ACCEPTING;
+        for (const char& symbol : input) {
+            state = table[state * num_classes + byte_class[(unsigned char)symbol]];
+            if (flags[state] & DECIDED) return flags[state] & ACCEPTING;
+        }
+        return flags[state] & ACCEPTING;
+    }
+
+    int numStates() const {
+        return flags.size();
+    }
+
+    int numClasses() const {
+        return num_classes;
+    }
+
+    int startState() const {
+        return start_state;
+    }
+
+    int deadState() const {
+        return dead_state;
+    }
+
+    int byteClass(unsigned char byte) const {
+        return byte_class[byte];
+    }
+
+    int next(int state, int cls) const {
+        return table[state * num_classes + cls];
+    }
+
+    uint8_t stateFlags(int state) const {
+        return flags[state];
+    }
+
+    // bytes used by the dense table
+    size_t memoryBytes() const {
+        return table.size() * sizeof(int32_t) + flags.size() + byte_class.size();
+    }
+
+    // number of states with each classification
+    std::tuple<int, int, int> classification() const {
+        int dead = 0, forever = 0, live = 0;
+        for (uint8_t f : flags) {
+            if (f & DEAD) dead++;
+            else if (f & ACCEPT_FOREVER) forever++;
+            else live++;
+        }
+        return {dead, forever, live};
+    }
+
+    /**
+     * @brief Match the whole input and count every state and transition visited
+     * Same answer as match, the profile must come from newProfile() of this table
+     *
+     * @param input
+     * @param profile
+     * @return true
+     * @return false
+     */
+
+    bool matchProfiled(const std::string& input, DFAProfile& profile) const {
+        int state = start_state;
+        profile.state_visits[state]++;
+        if (flags[state] & DECIDED) return flags[state] & ACCEPTING;
+        for (const char& symbol : input) {
+            int cls = byte_class[(unsigned char)symbol];
+            profile.transition_counts[state * num_classes + cls]++;
+            state = table[state * num_classes + cls];
+            profile.state_visits[state]++;
+            if (flags[state] & DECIDED) return flags[state] & ACCEPTING;
+        }
+        return flags[state] & ACCEPTING;
+    }
+
+    DFAProfile newProfile() const {
+        DFAProfile profile;
+        profile.state_visits.assign(numStates(), 0);
+        profile.transition_counts.assign(table.size(), 0);
+        return profile;
+    }
+
+    /**
+     * @brief Breadth first order of the states from the start state
+     * Depends only on the automaton, not on how it was numbered,
+     * so it is also the numbering used when a profile is saved
+     *
+     * @return std::vector<int> old state numbers in visiting order
+     */
+
+    std::vector<int> bfsOrder() const {
+        int n = numStates();
+        std::vector<int> order;
+        std::vector<bool> seen(n, false);
+        std::queue<int> queue;
+        queue.push(start_state);
+        seen[start_state] = true;
+        while (!queue.empty()) {
+            int s = queue.front();
+            queue.pop();
+            order.push_back(s);
+            for (int c = 0; c < num_classes; c++) {
+                int t = next(s, c);
+                if (!seen[t]) {
+                    seen[t] = true;
+                    queue.push(t);
+                }
+            }
+        }
+        for (int s = 0; s < n; s++) {
+            if (!seen[s]) order.push_back(s); // unreachable, kept for completeness
+        }
+        return order;
+    }
+
+    /**
+     * @brief Renumber the states so that states used together sit together
+     * Procedure
+     * 1. Without a profile the states are laid out in breadth first order from the start
+     * 2. With a profile the states are laid out by decreasing visit count,
+     *    ties keep the breadth first order
+     * 3. Rows of the table, flags and the start state are permuted accordingly
+     *
+     * @param profile optional, recorded on this table
+     * @return CompiledDFA
+     */
+
+    CompiledDFA relayout(const DFAProfile* profile = nullptr) const {
+        std::vector<int> order = bfsOrder();
+        if (profile) {
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return profile->state_visits[a] > profile->state_visits[b];
+            });
+        }
+
+        int n = numStates();
+        std::vector<int> new_number(n);
+        for (int i = 0; i < n; i++) new_number[order[i]] = i;
+
+        CompiledDFA result;
+        result.byte_class = byte_class;
+        result.num_classes = num_classes;
+        result.start_state = new_number[start_state];
+        result.dead_state = new_number[dead_state];
+        result.flags.resize(n);
+        result.table.resize(table.size());
+        for (int i = 0; i < n; i++) {
+            int old = order[i];
+            result.flags[i] = flags[old];
+            for (int c = 0; c < num_classes; c++) {
+                result.table[i * num_classes + c] = new_number[next(old, c)];
+            }
+        }
+        for (const auto& [state, number] : state_number) {
+            result.state_number[state] = new_number[number];
+        }
+        return result;
+    }
+
+    /**
+     * @brief Write the profile with states numbered in breadth first order
+     * so it can be loaded again for the same pattern compiled in another run
+     * format : "profile <states> <classes>", then "state <id> <visits>" and
+     * "transition <id> <class> <count>" lines for the non zero counts
+     *
+     * @param profile
+     * @param filename
+     */
+
+    void saveProfile(const DFAProfile& profile, const std::string& filename) const {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file");
+        }
+        std::vector<int> order = bfsOrder();
+        file << "profile " << numStates() << " " << num_classes << "\n";
+        for (int i = 0; i < order.size(); i++) {
+            int s = order[i];
+            if (profile.state_visits[s]) file << "state " << i << " " << profile.state_visits[s] << "\n";
+        }
+        for (int i = 0; i < order.size(); i++) {
+            int s = order[i];
+            for (int c = 0; c < num_classes; c++) {
+                uint64_t count = profile.transition_counts[s * num_classes + c];
+                if (count) file << "transition " << i << " " << c << " " << count << "\n";
+            }
+        }
+        file.close();
+    }
+
+    DFAProfile loadProfile(const std::string& filename) const {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file");
+        }
+        std::string kind;
+        int states, classes;
+        file >> kind >> states >> classes;
+        if (kind != "profile" || states != numStates() || classes != num_classes) {
+            throw std::runtime_error("Profile does not belong to this DFA");
+        }
+
+        std::vector<int> order = bfsOrder();
+        DFAProfile profile = newProfile();
+        while (file >> kind) {
+            int id = -1, cls = 0;
+            uint64_t count;
+            if (kind == "state") {
+                file >> id >> count;
+            } else if (kind == "transition") {
+                file >> id >> cls >> count;
+            } else {
+                throw std::runtime_error("Invalid profile format");
+            }
+            // a state or class out of range would land on the counts of another state
+            if (!file || id < 0 || id >= states || cls < 0 || cls >= num_classes) {
+                throw std::runtime_error("Invalid profile format");
+            }
+            if (kind == "state") profile.state_visits[order[id]] = count;
+            else profile.transition_counts[(size_t)order[id] * num_classes + cls] = count;
+        }
+        return profile;
+    }
+
+private:
+    std::unordered_map<State, int> state_number;
+    std::array<uint8_t, 256> byte_class{};
+    int num_classes = 1;
+    std::vector<int32_t> table;
+    std::vector<uint8_t> flags;
+    int start_state = 0;
+    int dead_state = 0;
+
+    void numberStates(const DFA& dfa) {
+        std::vector<State> dfa_states;
+        for (const auto& state_pair : dfa.getStates()) {
+            dfa_states.push_back(state_pair.first);
+        }
+        for (const auto& state : dfa.getAcceptingStates()) {
+            dfa_states.push_back(state);
+        }
+        dfa_states.push_back(dfa.getStartState());
+
+        for (const auto& state : dfa_states) {
+            if (state_number.find(state) == state_number.end()) {
+                int next = state_number.size();
+                state_number[state] = next;
+            }
+        }
+        dead_state = state_number.size();
+        start_state = state_number[dfa.getStartState()];
+    }
+
+    /**
+     * @brief Fill the dense table
+     * Procedure
+     * 1. Build the target of every (state, byte), missing transitions go to the dead state
+     * 2. Bytes whose targets agree in every state form one byte class
+     * 3. Keep one column per byte class
+     */
+
+    void buildTable(const DFA& dfa) {
+        int n = dead_state + 1;
+        std::vector<std::array<int32_t, 256>> delta(n);
+        for (auto& row : delta) row.fill(dead_state);
+        for (const auto& [state, transitions] : dfa.getStates()) {
+            for (const auto& [symbol, next_state] : transitions) {
+                CharSet set = labelCharSet(symbol); // a class label covers every byte of its class
+                for (int byte = 0; byte < 256; byte++) {
+                    if (set[byte]) delta[state_number[state]][byte] = state_number[next_state];
+                }
+            }
+        }
+
+        std::map<std::vector<int32_t>, int> column_class;
+        std::vector<int> representative;
+        for (int byte = 0; byte < 256; byte++) {
+            std::vector<int32_t> column(n);
+            for (int s = 0; s < n; s++) column[s] = delta[s][byte];
+            auto it = column_class.find(column);
+            if (it == column_class.end()) {
+                it = column_class.emplace(column, representative.size()).first;
+                representative.push_back(byte);
+            }
+            byte_class[byte] = it->second;
+        }
+        num_classes = representative.size();
+
+        table.assign(n * num_classes, dead_state);
+        for (int s = 0; s < n; s++) {
+            for (int c = 0; c < num_classes; c++) {
+                table[s * num_classes + c] = delta[s][representative[c]];
+            }
+        }
+
+        flags.assign(n, 0);
+        for (const auto& state : dfa.getAcceptingStates()) {
+            flags[state_number[state]] |= ACCEPTING;
+        }
+    }
+
+    /**
+     * @brief Classify every state as dead, accept forever or live
+     * Procedure
+     * 1. Dead : walk the reversed transitions from the accepting states,
+     *    every state that is not reached can never accept
+     * 2. Accept forever : start from all accepting states and repeatedly drop
+     *    a state that has some byte leading outside the set (greatest fixpoint)
+     * 3. Every other state is live
+     */
+
+    void classifyStates() {
+        int n = flags.size();
+        std::vector<std::vector<int>> reverse(n);
+        for (int s = 0; s < n; s++) {
+            for (int c = 0; c < num_classes; c++) {
+                reverse[next(s, c)].push_back(s);
+            }
+        }
+
+        std::vector<bool> reaches_accept(n, false);
+        std::stack<int> stack;
+        for (int s = 0; s < n; s++) {
+            if (flags[s] & ACCEPTING) {
+                reaches_accept[s] = true;
+                stack.push(s);
+            }
+        }
+        while (!stack.empty()) {
+            int s = stack.top();
+            stack.pop();
+            for (int prev : reverse[s]) {
+                if (!reaches_accept[prev]) {
+                    reaches_accept[prev] = true;
+                    stack.push(prev);
+                }
+            }
+        }
+
+        std::vector<bool> forever(n);
+        for (int s = 0; s < n; s++) forever[s] = flags[s] & ACCEPTING;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int s = 0; s < n; s++) {
+                if (!forever[s]) continue;
+                for (int c = 0; c < num_classes; c++) {
+                    if (!forever[next(s, c)]) {
+                        forever[s] = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (int s = 0; s < n; s++) {
+            if (!reaches_accept[s]) flags[s] |= DEAD;
+            if (forever[s]) flags[s] |= ACCEPT_FOREVER;
+        }
+    }
+};
+
+/**
+ * @brief Incremental matcher for input that arrives in chunks
+ * feed() may be called any number of times, once a dead or accept forever
+ * state is entered the answer is fixed and further chunks are ignored
+ */
+
+class StreamMatcher {
+public:
+    explicit StreamMatcher(const CompiledDFA& dfa) : dfa(dfa) {
+        reset();
+    }
+
+    void reset() {
+        state = dfa.startState();
+        consumed_bytes = 0;
+    }
+
+    /**
+     * @brief Consume the next chunk of the input
+     *
+     * @param data
+     * @param size
+     * @return false once the result is decided and no more input is needed
+     */
+
+    bool feed(const char* data, size_t size) {
+        if (decided()) return false;
+        for (size_t i = 0; i < size; i++) {
+            state = dfa.next(state, dfa.byteClass((unsigned char)data[i]));
+            if (dfa.stateFlags(state) & CompiledDFA::DECIDED) {
+                consumed_bytes += i + 1;
+                return false;
+            }
+        }
+        consumed_bytes += size;
+        return true;
+    }
+
+    bool feed(const std::string& chunk) {
+        return feed(chunk.data(), chunk.size());
+    }
+
+    bool decided() const {
+        return dfa.stateFlags(state) & CompiledDFA::DECIDED;
+    }
+
+    // answer for the input fed so far
+    bool accepted() const {
+        return dfa.stateFlags(state) & CompiledDFA::ACCEPTING;
+    }
+
+    size_t consumed() const {
+        return consumed_bytes;
+    }
+
+private:
+    const CompiledDFA& dfa;
+    int state;
+    size_t consumed_bytes;
+};
@@ -1,4 +1,9 @@
 #include"DFA.hpp"
+#include"prefilter.hpp"
+#include"compiledDFA.hpp"
+#include"simplify.hpp"
+#include"pikeVM.hpp"
+#include"tokenizer.hpp"
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -40,6 +45,12 @@ void drawParseTree(const std::shared_ptr<AstNode>& root, const std::string& file
             stack.push({unaryNode->left, nodeId});
         } else if (auto unaryNode = std::dynamic_pointer_cast<PlusAstNode>(node)) {
             stack.push({unaryNode->left, nodeId});
+        } else if (auto unaryNode = std::dynamic_pointer_cast<QuestionAstNode>(node)) {
+            stack.push({unaryNode->left, nodeId});
+        } else if (auto unaryNode = std::dynamic_pointer_cast<RepeatAstNode>(node)) {
+            stack.push({unaryNode->left, nodeId});
+        } else if (auto unaryNode = std::dynamic_pointer_cast<GroupAstNode>(node)) {
+            stack.push({unaryNode->left, nodeId});
         }
     }
 
@@ -72,7 +83,7 @@ void draw_nfa(const std::unordered_map<std::string, std::unordered_map<std::stri
         for (const auto& transition : state.second) {
             if (transition.first == "ending") continue;
             for (const auto& next_state : transition.second) {
-                std::string label = (transition.first == "epsilon") ? "ε" : transition.first;
+                std::string label = (transition.first == "epsilon") ? "ε" : printableLabel(transition.first);
                 dot_file << "    " << state.first << " -> " << next_state << " [ label = \"" << label << "\" ];\n";
             }
         }
@@ -108,7 +119,7 @@ void draw_dfa(const  std::pair<std::unordered_map<State ,int>,std::unordered_map
         if (state.first == "start") continue;
         for (const auto& transition : state.second) {
             if (transition.first == "ending") continue;
-            std::string label = transition.first;
+            std::string label = printableLabel(transition.first);
             dot_file << "    " << state.first << " -> " << transition.second << " [ label = \"" << label << "\" ];\n";
         }
     }
@@ -151,7 +162,7 @@ void draw_dfaTable(const  std::pair<std::unordered_map<State ,int>,std::unordere
         }
     }
     for (const auto& symbol : symbols) {
-        dot_file << "<td>" << symbol << "</td>";
+        dot_file << "<td>" << printableLabel(symbol) << "</td>";
     }
     dot_file << "</tr>\n";
 
@@ -185,17 +196,67 @@ void display_image(const std::string& filename) {
     system(command.c_str());
 }
 
-int main() {
+/**
+ * @brief Tokenizer mode : ./a.out --tokenize rules.txt [input]
+ * every line of the rules file is a rule name, a space and its regex, earlier lines win ties,
+ * the input file (stdin without one) is printed as "name offset length" lines
+ *
+ * @param rules_file
+ * @param input_file empty for stdin
+ */
+
+void tokenizeFile(const std::string& rules_file, const std::string& input_file) {
+    std::ifstream file(rules_file);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file");
+    }
+    std::vector<TokenRule> rules;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            throw std::runtime_error("Rule without a regex : " + line);
+        }
+        rules.push_back({line.substr(0, space), line.substr(space + 1)});
+    }
+    Tokenizer tokenizer(rules);
+    auto print = [&](const Lexeme& token) {
+        std::cout << tokenizer.ruleName(token.kind) << " " << token.offset << " " << token.length << "\n";
+    };
+    if (input_file.empty()) {
+        tokenizer.tokenize(std::cin, print);
+        return;
+    }
+    std::ifstream input(input_file, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error("Could not open file");
+    }
+    tokenizer.tokenize(input, print);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && std::string(argv[1]) == "--tokenize") {
+        tokenizeFile(argv[2], argc >= 4 ? argv[3] : "");
+        return 0;
+    }
     while(true) {
         std::string regex ;
         std::cout << "Enter the regex : ";
-        std::cin >> regex;
+        if (!(std::cin >> regex)) break;
 
         auto tokenStream = lexer(regex);
         auto parser = ParseRegex(tokenStream);
-        std::shared_ptr<AstNode> root = parser.parse();
+        std::shared_ptr<AstNode> written = parser.parse();
+        std::shared_ptr<AstNode> root = simplifyRegex(written);
         NFA nfa(root);
 
+        NFA written_nfa(written);
+        DFA written_dfa(written_nfa);
+        std::cout << "Simplified : " << regexString(root) << "\n";
+        std::cout << "AST nodes  : " << countAstNodes(written) << " -> " << countAstNodes(root) << "\n";
+        std::cout << "NFA states : " << written_nfa.getStates().size() << " -> " << nfa.getStates().size() << "\n";
+
 
         drawParseTree(root, "parse_tree");
         auto nfa_dict = nfa.nfaStruct() ;
@@ -206,6 +267,7 @@ int main() {
         display_image("nfa");
 
         DFA dfa(nfa);
+        std::cout << "DFA states : " << written_dfa.getStates().size() << " -> " << dfa.getStates().size() << "\n";
         // auto dfa_dict = dfa.dfaStruct();
         // draw_dfa(dfa_dict, "dfa");
         // save_json_DFA(dfa_dict, "dfa.json");
@@ -217,18 +279,48 @@ int main() {
         draw_dfaTable(dfa_dict, "dfa_moore_minimizedTable");
         display_image("dfa_moore_minimized");
 
+        CompiledDFA compiled(dfa);
+        auto [dead, forever, live] = compiled.classification();
+        std::cout << "States : " << dead << " dead, " << forever << " accept forever, " << live << " live\n";
+
 
         
         std::string command = "rm -f parse_tree.dot nfa.dot dfa.dot nfa.json dfa.json dfa_moore_minimized.json dfa_moore_minimized.dot dfa_moore_minimizedTable.dot dfa_moore_minimizedTable.json";
         system(command.c_str());
         
         
-        std::string input ;
-        std::cout << "Write `empty` for empty string test\n" ;
-        std::cout << "Enter the input string : ";
-        std::cin >> input;
-        if (input == "empty") input = "";
-        (dfa.match(input)) ? std::cout << "Matched\n" : std::cout << "Not Matched\n";
+        // one prefilter per pattern, its counts add up over every input tried
+        PrefilteredDFA matcher(dfa, root);
+        PrefilteredPikeVM vm(written);
+        const LiteralInfo& literals = matcher.getPrefilter().literals();
+        std::cout << "Required literals : prefix \"" << literals.prefix << "\" suffix \"" << literals.suffix
+                  << "\" factor \"" << literals.factor << "\"\n";
+        while (true) {
+            std::string input ;
+            std::cout << "Write `empty` for empty string test, `next` for a new regex\n" ;
+            std::cout << "Enter the input string : ";
+            if (!(std::cin >> input) || input == "next") break;
+            if (input == "empty") input = "";
+            size_t rejected = matcher.getPrefilter().rejectedCount();
+            bool matched = matcher.match(input);
+            matched ? std::cout << "Matched\n" : std::cout << "Not Matched\n";
+            if (matcher.getPrefilter().rejectedCount() > rejected) std::cout << "(rejected by the prefilter)\n";
+            std::cout << "Prefilter : " << matcher.getPrefilter().rejectedCount() << " of "
+                      << matcher.getPrefilter().checkedCount() << " inputs rejected\n";
+            if (!matched) {
+                // the search skips inputs that lack a required literal
+                if (auto found = vm.search(input)) {
+                    auto [begin, end] = found->span();
+                    std::cout << "Leftmost match : [" << begin << ", " << end << ") \"" << input.substr(begin, end - begin) << "\"\n";
+                }
+            } else if (auto captures = vm.match(input)) {
+                for (int g = 1; g < captures->groups.size(); g++) {
+                    auto [begin, end] = captures->groups[g];
+                    std::cout << "Group " << g << " : ";
+                    begin < 0 ? std::cout << "unset\n" : std::cout << "[" << begin << ", " << end << ") \"" << input.substr(begin, end - begin) << "\"\n";
+                }
+            }
+        }
         std::cout << "\n\n\n\n\n\n" ;
     }
 
@@ -1,4 +1,5 @@
-#include<bits/stdc++.h>
+#pragma once
+#include "utf8.hpp"
 
 #define OR 1
 #define STAR 2
@@ -6,6 +7,11 @@
 #define OPEN_PAREN 4
 #define CLOSED_PAREN 5
 #define LITERAL 6
+#define QUESTION 7
+#define DOT 8
+#define CHAR_CLASS 9 // content is the label of the class
+#define REPEAT 10 // content is "m", "m," or "m,n"
+#define UNICODE_CLASS 11 // content is rangesContent of the code points, see utf8.hpp
 
 std::pair<int,std::string> getTokenType(char token) {
     if(token == '|') return {OR, "OR"} ;
@@ -13,6 +19,8 @@ std::pair<int,std::string> getTokenType(char token) {
     if(token == '+') return {PLUS, "PLUS"} ;
     if(token == '(') return {OPEN_PAREN, "OPEN_PAREN"} ;
     if(token == ')') return {CLOSED_PAREN, "CLOSED_PAREN"} ;
+    if(token == '?') return {QUESTION, "QUESTION"} ;
+    if(token == '.') return {DOT, "DOT"} ;
     return {LITERAL, "LITERAL"} ;
 }
 
@@ -22,6 +30,11 @@ char getTokenVal(int token) {
     if(token == PLUS) return '+' ;
     if(token == OPEN_PAREN) return '(' ;
     if(token == CLOSED_PAREN) return ')' ;
+    if(token == QUESTION) return '?' ;
+    if(token == DOT) return '.' ;
+    if(token == CHAR_CLASS) return '[' ;
+    if(token == REPEAT) return '{' ;
+    if(token == UNICODE_CLASS) return '[' ;
     return token ;
 }
 
@@ -44,9 +57,157 @@ struct Token {
     }
 };
 
+// the character after a backslash, \n \t \r are control characters, anything else is itself
+char escapedChar(char c) {
+    if (c == 'n') return '\n';
+    if (c == 't') return '\t';
+    if (c == 'r') return '\r';
+    return c;
+}
+
+// the code point of regex[i], a byte when patterns are not UTF-8
+uint32_t lexCodePoint(const std::string& regex, int& i) {
+    if (!utf8_patterns || (unsigned char)regex[i] < 0x80) return (unsigned char)regex[i];
+    int at = i;
+    if (auto code_point = decodeUtf8(regex, i)) return *code_point;
+    throw std::runtime_error("Invalid UTF-8 in pattern at " + std::to_string(at));
+}
+
+/**
+ * @brief The code point of an escape, regex[i] is the character after the backslash
+ * \xNN with two hex digits is the byte NN, or the code point U+00NN in a UTF-8 pattern,
+ * so every byte can be written in printable form. \n \t \r are control characters,
+ * anything else is itself
+ *
+ * @param regex
+ * @param i index after the backslash, moved to the last character of the escape
+ * @return uint32_t
+ */
+
+uint32_t lexEscape(const std::string& regex, int& i) {
+    if (regex[i] == 'x' && i + 2 < regex.size() && std::isxdigit((unsigned char)regex[i + 1]) && std::isxdigit((unsigned char)regex[i + 2])) {
+        i += 2;
+        return std::stoi(regex.substr(i - 1, 2), nullptr, 16);
+    }
+    if ((unsigned char)regex[i] >= 0x80) return lexCodePoint(regex, i);
+    return (unsigned char)escapedChar(regex[i]);
+}
+
+// a single code point : a byte literal, or a class of one code point for the bytes of a non ASCII one
+Token codePointToken(uint32_t code_point) {
+    if (code_point < 0x80 || !utf8_patterns) return Token("LITERAL", char(code_point), LITERAL);
+    return Token("UNICODE_CLASS", '[', UNICODE_CLASS, rangesContent({{code_point, code_point}}));
+}
+
+/**
+ * @brief Lex a bracket class starting at regex[i] == '['
+ * Procedure
+ * 1. '^' right after '[' negates the class
+ * 2. ']' right after '[' or "[^" is a literal, any other ']' closes the class
+ * 3. a - b is the range from a to b, '-' first or last is a literal
+ * 4. backslash escapes work inside the class as well, \xNN included
+ * 5. with utf8_patterns the members are code points, a class of ASCII members stays a
+ *    byte class, one with other code points or negated (it then holds all but its members)
+ *    is a UNICODE_CLASS
+ *
+ * @param regex
+ * @param i index of '[', moved to the closing ']'
+ * @return Token CHAR_CLASS with the label of the class, or UNICODE_CLASS
+ */
+
+Token lexCharClass(const std::string& regex, int& i) {
+    int open = i++;
+    bool negated = i < regex.size() && regex[i] == '^';
+    if (negated) i++;
+    CodePointRanges ranges;
+    bool first = true;
+    while (true) {
+        if (i >= regex.size()) {
+            throw std::runtime_error("Unterminated character class at " + std::to_string(open));
+        }
+        if (regex[i] == ']' && !first) break;
+        first = false;
+        uint32_t low = regex[i] == '\\' && i + 1 < regex.size() ? lexEscape(regex, ++i) : lexCodePoint(regex, i);
+        uint32_t high = low;
+        if (i + 2 < regex.size() && regex[i + 1] == '-' && regex[i + 2] != ']') {
+            i += 2;
+            high = regex[i] == '\\' && i + 1 < regex.size() ? lexEscape(regex, ++i) : lexCodePoint(regex, i);
+            if (high < low) {
+                throw std::runtime_error("Invalid range in character class at " + std::to_string(open));
+            }
+        }
+        ranges.push_back({low, high});
+        i++;
+    }
+    ranges = normalizeRanges(ranges);
+    if (utf8_patterns && (negated || (!ranges.empty() && ranges.back().second >= 0x80))) {
+        if (negated) ranges = complementRanges(ranges);
+        return Token("UNICODE_CLASS", '[', UNICODE_CLASS, rangesContent(ranges));
+    }
+    CharSet set;
+    for (const auto& [low, high] : ranges) {
+        for (uint32_t c = low; c <= high; c++) set.set(c);
+    }
+    if (negated) set.flip();
+    return Token("CHAR_CLASS", '[', CHAR_CLASS, charSetLabel(set));
+}
+
+/**
+ * @brief Lex a bounded repetition {m}, {m,} or {m,n} starting at regex[i] == '{'
+ *
+ * @param regex
+ * @param i index of '{', moved to the closing '}' on success
+ * @return std::optional<std::string> "m", "m," or "m,n", empty if '{' is a literal
+ */
+
+std::optional<std::string> lexRepeat(const std::string& regex, int& i) {
+    int j = i + 1;
+    auto digits = [&]() {
+        int start = j;
+        while (j < regex.size() && std::isdigit((unsigned char)regex[j])) j++;
+        if (j - start > 9) throw std::runtime_error("Repetition count too large at " + std::to_string(i));
+        return regex.substr(start, j - start);
+    };
+    std::string low = digits();
+    if (low.empty()) return std::nullopt;
+    std::string content = low;
+    if (j < regex.size() && regex[j] == ',') {
+        j++;
+        std::string high = digits();
+        if (!high.empty() && std::stoi(high) < std::stoi(low)) {
+            throw std::runtime_error("Invalid repetition bounds at " + std::to_string(i));
+        }
+        content += "," + high;
+    }
+    if (j >= regex.size() || regex[j] != '}') return std::nullopt;
+    i = j;
+    return content;
+}
+
 std::vector<Token> lexer(std::string regex) {
     std::vector<Token> tokenStream;
     for(int i = 0; i < regex.size(); i++) {
+        if (regex[i] == '\\' && i + 1 < regex.size()) {
+            i++;
+            tokenStream.push_back(codePointToken(lexEscape(regex, i)));
+            continue;
+        }
+        if (regex[i] == '[') {
+            tokenStream.push_back(lexCharClass(regex, i));
+            continue;
+        }
+        if ((unsigned char)regex[i] >= 0x80) {
+            tokenStream.push_back(codePointToken(lexCodePoint(regex, i)));
+            continue;
+        }
+        if (regex[i] == '{') {
+            int at = i;
+            if (auto bounds = lexRepeat(regex, i)) {
+                tokenStream.push_back(Token("REPEAT", '{', REPEAT, *bounds));
+                continue;
+            }
+            i = at;
+        }
         auto it = getTokenType(regex[i]);
         Token token(it.second, regex[i],it.first);
         tokenStream.push_back(token);
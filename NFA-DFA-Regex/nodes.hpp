@@ -1,3 +1,4 @@
+#pragma once
 #include"lex.hpp"
 class AstNode {
 public:
@@ -5,6 +6,31 @@ public:
     virtual std::string getLabel() const = 0;
 };
 
+/**
+ * @brief Drop the children of a node being destroyed without recursing
+ * The first destructor of a chain owns a worklist, every destructor it triggers only
+ * moves its children there, so a tree a million nodes deep is freed in a loop
+ *
+ * @param children the child pointers of the node, emptied
+ */
+
+void releaseChildren(std::initializer_list<std::shared_ptr<AstNode>*> children) {
+    static thread_local std::vector<std::shared_ptr<AstNode>>* pending = nullptr;
+    std::vector<std::shared_ptr<AstNode>> worklist;
+    bool owner = pending == nullptr;
+    if (owner) pending = &worklist;
+    for (auto* child : children) {
+        if (*child) pending->push_back(std::move(*child));
+    }
+    if (!owner) return;
+    while (!worklist.empty()) {
+        std::shared_ptr<AstNode> node = std::move(worklist.back());
+        worklist.pop_back();
+        node.reset(); // its destructor may push its own children
+    }
+    pending = nullptr;
+}
+
 class OrAstNode : public AstNode {
 
 public:
@@ -15,6 +41,9 @@ public:
         this->left = left;
         this->right = right;
     }
+    ~OrAstNode() override {
+        releaseChildren({&left, &right});
+    }
     std::string getLabel() const override {
         return "|";
     }
@@ -31,6 +60,9 @@ public:
         this->left = left;
         this->right = right;
     }
+    ~SeqAstNode() override {
+        releaseChildren({&left, &right});
+    }
     std::string getLabel() const override {
         return "&";
     }
@@ -46,6 +78,9 @@ public:
     explicit StarAstNode(std::shared_ptr<AstNode> left) {
         this->left = left;
     }
+    ~StarAstNode() override {
+        releaseChildren({&left});
+    }
     std::string getLabel() const override {
         return "*";
     }
@@ -60,6 +95,9 @@ public:
     explicit PlusAstNode(std::shared_ptr<AstNode> left) {
         this->left = left ;
     }
+    ~PlusAstNode() override {
+        releaseChildren({&left});
+    }
     std::string getLabel() const override {
         return "+";
     }
@@ -78,3 +116,83 @@ public:
         return std::string(1, ch);
     }
 };
+
+class QuestionAstNode : public AstNode {
+public:
+    std::shared_ptr<AstNode> left;
+
+    explicit QuestionAstNode(std::shared_ptr<AstNode> left) {
+        this->left = left;
+    }
+    ~QuestionAstNode() override {
+        releaseChildren({&left});
+    }
+    std::string getLabel() const override {
+        return "?";
+    }
+};
+
+// '(' left ')', capture group number index, groups are numbered by their '(' from 1
+class GroupAstNode : public AstNode {
+public:
+    std::shared_ptr<AstNode> left;
+    int index;
+
+    GroupAstNode(std::shared_ptr<AstNode> left, int index) {
+        this->left = left;
+        this->index = index;
+    }
+    ~GroupAstNode() override {
+        releaseChildren({&left});
+    }
+    std::string getLabel() const override {
+        return "( )" + std::to_string(index);
+    }
+};
+
+// a bracket class or '.', one edge of the NFA whatever its size
+class CharClassAstNode : public AstNode {
+public:
+    CharSet set;
+
+    explicit CharClassAstNode(const CharSet& set) {
+        this->set = set;
+    }
+    std::string getLabel() const override {
+        return printableLabel(charSetLabel(set));
+    }
+};
+
+// a class of code points of a UTF-8 pattern, read as the UTF-8 bytes of one of them
+class CodePointClassAstNode : public AstNode {
+public:
+    CodePointRanges ranges;
+
+    explicit CodePointClassAstNode(const CodePointRanges& ranges) {
+        this->ranges = ranges;
+    }
+    std::string getLabel() const override {
+        return codePointRangesLabel(ranges);
+    }
+};
+
+// left{min,max}, max is -1 when unbounded
+class RepeatAstNode : public AstNode {
+public:
+    std::shared_ptr<AstNode> left;
+    int min;
+    int max;
+
+    RepeatAstNode(std::shared_ptr<AstNode> left, int min, int max) {
+        this->left = left;
+        this->min = min;
+        this->max = max;
+    }
+    ~RepeatAstNode() override {
+        releaseChildren({&left});
+    }
+    std::string getLabel() const override {
+        if (min == max) return "{" + std::to_string(min) + "}";
+        return "{" + std::to_string(min) + "," + (max < 0 ? "" : std::to_string(max)) + "}";
+    }
+};
@@ -1,3 +1,4 @@
+#pragma once
 #include "nodes.hpp"
 
 //CFG
@@ -7,87 +8,84 @@
 // U -> C
 // C -> C K
 // C -> K
-// K -> S '*'
-// K -> S '+'
+// K -> K '*'
+// K -> K '+'
+// K -> K '?'
+// K -> K '{m,n}'
 // K -> S
-// S -> '(' R ')'
+// S -> '(' R ')'      capture group, numbered by its '('
 // S -> LITERAL
+// S -> '[' class ']'
+// S -> '.'
+// S -> UNICODE_CLASS   code points of a UTF-8 pattern, a non ASCII literal is a class of one
 // S -> epsilon
 
 //studied in compiler design
 
 
+// The grammar is parsed without recursion : one frame per open parenthesis on an
+// explicit stack, so nesting depth and pattern length are only bounded by memory
+
 class ParseRegex {
 private:
     std::vector<Token> tokenStream;
     int currToken;
+    int groups = 0;
 
-    std::shared_ptr<AstNode> parse_R() {
-        return parse_U();
-    }
+    // the U being parsed inside one pair of parentheses (or the whole regex)
+    struct Frame {
+        int group;                            // index of the group, 0 for the whole regex
+        std::shared_ptr<AstNode> alternation; // U of the branches before the last '|'
+        bool has_alternation = false;
+        std::shared_ptr<AstNode> sequence;    // C of the current branch, without its last K
+        bool has_sequence = false;
+        std::shared_ptr<AstNode> term;        // last K, postfix operators still apply to it
+        bool has_term = false;
+    };
 
-    std::shared_ptr<AstNode> parse_U() {
-        std::shared_ptr<AstNode> ast = parse_C();
-        while (isMatch(OR)) {
-            std::shared_ptr<AstNode> left = ast;
-            std::shared_ptr<AstNode> right = parse_C();
-            ast = std::make_shared<OrAstNode>(left, right);
-        }
-        return ast;
+    static bool startsAtom(int tokenType) {
+        return tokenType == LITERAL || tokenType == CHAR_CLASS || tokenType == DOT || tokenType == UNICODE_CLASS;
     }
 
-    std::shared_ptr<AstNode> parse_C() {
-        std::shared_ptr<AstNode> ast = parse_K();
-        while (currToken < tokenStream.size()) {
-            int tokenType = tokenStream[currToken].index;
-            if (tokenType == LITERAL || tokenType == OPEN_PAREN) {
-                std::shared_ptr<AstNode> left = ast;
-                std::shared_ptr<AstNode> right = parse_K();
-                ast = std::make_shared<SeqAstNode>(left, right);
-            } else {
-                break;
-            }
-        }
-        return ast;
+    // S -> LITERAL | '[' class ']' | '.' | UNICODE_CLASS
+    std::shared_ptr<AstNode> atom(const Token& token) const {
+        if (token.index == LITERAL) return std::make_shared<LiteralCharacterAstNode>(token.val);
+        if (token.index == CHAR_CLASS) return std::make_shared<CharClassAstNode>(labelCharSet(token.content));
+        if (token.index == UNICODE_CLASS) return std::make_shared<CodePointClassAstNode>(contentRanges(token.content));
+        if (utf8_patterns) return std::make_shared<CodePointClassAstNode>(anyCodePointButNewline());
+        return std::make_shared<CharClassAstNode>(anyButNewline());
     }
 
-    std::shared_ptr<AstNode> parse_K() {
-        std::shared_ptr<AstNode> ast = parse_S();
-        if (isMatch(STAR)) {
-            ast = std::make_shared<StarAstNode>(ast);
-        } else if (isMatch(PLUS)) {
-            ast = std::make_shared<PlusAstNode>(ast);
-        }
-        return ast;
+    // K -> K '*' | K '+' | K '?' | K '{m,n}'
+    std::shared_ptr<AstNode> postfix(const Token& token, const std::shared_ptr<AstNode>& ast) const {
+        if (token.index == STAR) return std::make_shared<StarAstNode>(ast);
+        if (token.index == PLUS) return std::make_shared<PlusAstNode>(ast);
+        if (token.index == QUESTION) return std::make_shared<QuestionAstNode>(ast);
+        const std::string& bounds = token.content;
+        size_t comma = bounds.find(',');
+        int min = std::stoi(bounds.substr(0, comma));
+        int max = min;
+        if (comma != std::string::npos) max = comma + 1 == bounds.size() ? -1 : std::stoi(bounds.substr(comma + 1));
+        return std::make_shared<RepeatAstNode>(ast, min, max);
     }
 
-    std::shared_ptr<AstNode> parse_S() {
-        if (isMatch(OPEN_PAREN)) {
-            std::shared_ptr<AstNode> ast = parse_R();
-            check(CLOSED_PAREN);
-            return ast;
-        } else if (isMatch(LITERAL)) {
-            return std::make_shared<LiteralCharacterAstNode>(tokenStream[currToken - 1].val);
-        } else {
-            return nullptr;
-        }
-    }
-
-    bool isMatch(int tokenType) {
-        if (currToken >= tokenStream.size()) {
-            return false;
-        }
-        if (tokenStream[currToken].index == tokenType) {
-            currToken++;
-            return true;
-        }
-        return false;
+    // C -> C K : the last K is complete once the next one starts
+    static void closeTerm(Frame& frame) {
+        if (!frame.has_term) return;
+        frame.sequence = frame.has_sequence ? std::make_shared<SeqAstNode>(frame.sequence, frame.term) : frame.term;
+        frame.has_sequence = true;
+        frame.term = nullptr;
+        frame.has_term = false;
     }
 
-    void check(int tokenType) {
-        if (!isMatch(tokenType)) {
-            throw std::runtime_error("Expected token");
-        }
+    // U -> U '|' C : the current branch is complete
+    static void closeBranch(Frame& frame) {
+        closeTerm(frame);
+        std::shared_ptr<AstNode> branch = frame.sequence; // epsilon when the branch is empty
+        frame.alternation = frame.has_alternation ? std::make_shared<OrAstNode>(frame.alternation, branch) : branch;
+        frame.has_alternation = true;
+        frame.sequence = nullptr;
+        frame.has_sequence = false;
     }
 
 public:
@@ -96,12 +94,60 @@ public:
         currToken = 0;
     }
 
+    /**
+     * @brief Build the AST of the token stream
+     * Procedure for every token
+     * 1. an atom closes the last K of the frame and becomes the new one
+     * 2. a postfix operator wraps the last K, or epsilon if the branch has none yet
+     * 3. '|' closes the branch of the frame
+     * 4. '(' opens a frame numbered as the next group, ')' closes it and its
+     *    group node becomes the last K of the enclosing frame
+     * The trees are the ones of the left recursive grammar above.
+     *
+     * @return std::shared_ptr<AstNode> nullptr for the empty regex
+     */
+
     std::shared_ptr<AstNode> parse() {
-        std::shared_ptr<AstNode> ast = parse_R();
-        if (currToken < tokenStream.size()) {
-            throw std::runtime_error("Unchecked token");
+        std::vector<Frame> frames(1);
+        frames[0].group = 0;
+        for (; currToken < tokenStream.size(); currToken++) {
+            const Token& token = tokenStream[currToken];
+            Frame& frame = frames.back();
+            if (startsAtom(token.index)) {
+                closeTerm(frame);
+                frame.term = atom(token);
+                frame.has_term = true;
+            } else if (token.index == STAR || token.index == PLUS || token.index == QUESTION || token.index == REPEAT) {
+                frame.term = postfix(token, frame.has_term ? frame.term : nullptr);
+                frame.has_term = true;
+            } else if (token.index == OR) {
+                closeBranch(frame);
+            } else if (token.index == OPEN_PAREN) {
+                closeTerm(frame);
+                frames.emplace_back();
+                frames.back().group = ++groups;
+            } else if (token.index == CLOSED_PAREN) {
+                if (frames.size() == 1) {
+                    throw std::runtime_error("Unchecked token");
+                }
+                closeBranch(frame);
+                std::shared_ptr<AstNode> group = std::make_shared<GroupAstNode>(frame.alternation, frame.group);
+                frames.pop_back();
+                frames.back().term = group;
+                frames.back().has_term = true;
+            } else {
+                throw std::runtime_error("Unchecked token");
+            }
         }
-        return ast;
+        if (frames.size() > 1) {
+            throw std::runtime_error("Expected token");
+        }
+        closeBranch(frames[0]);
+        return frames[0].alternation;
     }
-};
 
+    // capture groups of the parsed regex, group 0 (the whole match) not counted
+    int groupCount() const {
+        return groups;
+    }
+};
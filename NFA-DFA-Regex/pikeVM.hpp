@@ -0,0 +1,463 @@
+#pragma once
+#include "NFA.hpp"
+
+// Pike VM : the NFA as a small instruction program, simulated one input byte at a
+// time with every live thread in lockstep, so submatches come without backtracking
+
+enum class Opcode {
+    CHAR,  // read ch
+    CLASS, // read a byte of classes[set]
+    SPLIT, // continue at x and at y, x has priority
+    JMP,   // continue at x
+    SAVE,  // slots[slot] = current position
+    MATCH
+};
+
+size_t capture_slot_budget = 1 << 26; // most capture slots a thread list of the Pike VM may hold
+
+struct Instruction {
+    Opcode op;
+    char ch = 0;
+    int x = 0;
+    int y = 0;
+    int slot = 0;
+    int set = 0;
+};
+
+// spans of the whole match (group 0) and of every capture group, {-1, -1} if the group took no part
+struct PikeMatch {
+    std::vector<std::pair<int, int>> groups;
+
+    std::pair<int, int> span() const {
+        return groups[0];
+    }
+};
+
+/**
+ * @brief Pike VM over the AST of ParseRegex
+ * Procedure of a run
+ * 1. the thread list of position i holds at most one thread per instruction (a sparse set),
+ *    in priority order, every thread with its own capture slots
+ * 2. addThread follows JMP, SPLIT and SAVE with an explicit stack, a SAVE pushes the
+ *    old value of its slot so the next branch of a SPLIT sees it restored
+ * 3. a CHAR or CLASS thread that reads input[i] is added to the list of position i + 1
+ * 4. a MATCH thread records its slots and cuts the threads of lower priority
+ * Every instruction is visited at most once per position : O(n * m) time, and all
+ * lists and slots are allocated with the program, not per input byte.
+ * Among the matches of the leftmost start, the one of the highest priority wins :
+ * the left branch of '|', greedy '*', '+', '?' and '{m,n}'
+ */
+
+class PikeVM {
+public:
+    explicit PikeVM(const std::shared_ptr<AstNode>& ast) {
+        groups = countGroups(ast) + 1;
+        emit(Opcode::SAVE).slot = 0;
+        compile(ast);
+        emit(Opcode::SAVE).slot = 1;
+        emit(Opcode::MATCH);
+
+        // only a thread resting on char, class or match keeps slots, one row each
+        int rows = 0;
+        slot_row.assign(program.size(), -1);
+        for (int pc = 0; pc < program.size(); pc++) {
+            Opcode op = program[pc].op;
+            if (op == Opcode::CHAR || op == Opcode::CLASS || op == Opcode::MATCH) slot_row[pc] = rows++;
+        }
+        size_t slots = groups * 2;
+        if ((size_t)rows * slots > capture_slot_budget) {
+            throw std::runtime_error("Pike VM needs " + std::to_string((size_t)rows * slots) + " capture slots per thread list, over the budget of " +
+                                     std::to_string(capture_slot_budget));
+        }
+        for (ThreadList* list : {&current, &next}) {
+            list->dense.resize(program.size());
+            list->sparse.resize(program.size());
+            list->slots.resize(rows * slots);
+        }
+        scratch.resize(slots);
+        matched.resize(slots);
+        stack.reserve(program.size() * 2);
+    }
+
+    // the whole input matches, with the spans of its groups
+    std::optional<PikeMatch> match(std::string_view input) {
+        return run(input, true);
+    }
+
+    // leftmost match anywhere in the input
+    std::optional<PikeMatch> search(std::string_view input) {
+        return run(input, false);
+    }
+
+    const std::vector<Instruction>& getProgram() const {
+        return program;
+    }
+
+    // capture groups, group 0 included
+    int groupCount() const {
+        return groups;
+    }
+
+    void printProgram(std::ostream& out) const {
+        for (int pc = 0; pc < program.size(); pc++) {
+            const Instruction& inst = program[pc];
+            out << pc << " ";
+            switch (inst.op) {
+                case Opcode::CHAR: out << "char " << printableLabel(std::string(1, inst.ch)); break;
+                case Opcode::CLASS: out << "class " << printableLabel(charSetLabel(classes[inst.set])); break;
+                case Opcode::SPLIT: out << "split " << inst.x << ", " << inst.y; break;
+                case Opcode::JMP: out << "jmp " << inst.x; break;
+                case Opcode::SAVE: out << "save " << inst.slot; break;
+                case Opcode::MATCH: out << "match"; break;
+            }
+            out << "\n";
+        }
+    }
+
+private:
+    struct ThreadList {
+        std::vector<int> dense;  // instructions of the threads, in priority order
+        std::vector<int> sparse; // instruction -> its index in dense
+        std::vector<int> slots;  // capture slots of the thread at instruction pc, at slot_row[pc] * slots per thread
+        int size = 0;
+
+        bool contains(int pc) const {
+            int k = sparse[pc];
+            return k < size && dense[k] == pc;
+        }
+        void insert(int pc) {
+            sparse[pc] = size;
+            dense[size++] = pc;
+        }
+    };
+
+    // what addThread still has to do : follow pc, or restore slot to value
+    struct Job {
+        int pc;
+        int slot; // -1 for a pc to follow
+        int value;
+    };
+
+    // what compile still has to do : the code of a node, or the step that follows an operand
+    enum class Step {
+        CODE,
+        OR_BRANCH,       // left is done : jmp past the right side, the split's y is here
+        OR_END,          // right is done : the jmp lands here
+        STAR_BEGIN,      // code of node as the body of a star
+        STAR_END,        // jmp back to the split, the split's y is here
+        PLUS_END,        // split back to the start of the body
+        QUESTION_END,    // the split's y is here
+        GROUP_END,       // save the closing slot
+        REPEAT_MEASURED, // the first copy is done, check the budget and queue the other copies
+        REPEAT_OPTIONAL, // split before an optional copy
+        REPEAT_END       // every optional split skips to here
+    };
+
+    struct Task {
+        Step step;
+        std::shared_ptr<AstNode> node;
+        int at = 0; // instruction to patch, slot to save or where the first copy started
+    };
+
+    std::vector<Instruction> program;
+    std::vector<CharSet> classes;
+    std::vector<int> slot_row; // pc -> its row of slots, -1 where no thread rests
+    int groups;
+
+    ThreadList current, next;
+    std::vector<int> scratch; // slots of the thread being added
+    std::vector<int> matched;
+    std::vector<Job> stack;
+
+    Instruction& emit(Opcode op) {
+        program.push_back(Instruction{op});
+        return program.back();
+    }
+
+    int countGroups(const std::shared_ptr<AstNode>& node) const {
+        int count = 0;
+        std::vector<std::shared_ptr<AstNode>> stack = {node};
+        while (!stack.empty()) {
+            std::shared_ptr<AstNode> top = std::move(stack.back());
+            stack.pop_back();
+            if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(top)) {
+                count = std::max(count, group_node->index);
+                stack.push_back(group_node->left);
+            } else if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(top)) {
+                stack.push_back(or_node->left);
+                stack.push_back(or_node->right);
+            } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(top)) {
+                stack.push_back(seq_node->left);
+                stack.push_back(seq_node->right);
+            } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(top)) {
+                stack.push_back(star_node->left);
+            } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(top)) {
+                stack.push_back(plus_node->left);
+            } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(top)) {
+                stack.push_back(question_node->left);
+            } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(top)) {
+                stack.push_back(repeat_node->left);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief Append the code of a node to the program
+     * Procedure
+     * 1. literal    : char c
+     * 2. class      : class k
+     * 3. seq        : code of left, code of right
+     * 4. or         : split L1, L2; L1: left; jmp L3; L2: right; L3:
+     * 5. star       : L1: split L2, L3; L2: code; jmp L1; L3:
+     * 6. plus       : L1: code; split L1, L2; L2:
+     * 7. question   : split L1, L2; L1: code; L2:
+     * 8. group k    : save 2k; code; save 2k + 1
+     * 10. code point class : the byte range sequences of its UTF-8 as an alternation of class runs
+     * 9. repeat     : X{m,n} as m copies and n - m nested optional copies, X{m,} ends with a star,
+     *                 limited by repetition_budget instructions like the NFA
+     * epsilon (a null node) emits nothing
+     * Operands are compiled from an explicit task stack, what follows an operand (a jmp,
+     * patching a split, the closing save) is a task queued under it
+     *
+     * @param node
+     */
+
+    void compile(const std::shared_ptr<AstNode>& node) {
+        std::vector<Task> tasks = {{Step::CODE, node}};
+        std::vector<std::vector<int>> optional_splits; // of the bounded repeats being compiled, innermost last
+        while (!tasks.empty()) {
+            Task task = std::move(tasks.back());
+            tasks.pop_back();
+            switch (task.step) {
+                case Step::CODE: code(task.node, tasks); break;
+                case Step::OR_BRANCH: {
+                    int jmp = program.size();
+                    emit(Opcode::JMP);
+                    program[task.at].y = program.size();
+                    tasks.push_back({Step::OR_END, nullptr, jmp});
+                    tasks.push_back({Step::CODE, std::static_pointer_cast<OrAstNode>(task.node)->right});
+                    break;
+                }
+                case Step::OR_END: program[task.at].x = program.size(); break;
+                case Step::STAR_BEGIN: {
+                    int split = program.size();
+                    emit(Opcode::SPLIT).x = split + 1;
+                    tasks.push_back({Step::STAR_END, nullptr, split});
+                    tasks.push_back({Step::CODE, task.node});
+                    break;
+                }
+                case Step::STAR_END:
+                    emit(Opcode::JMP).x = task.at;
+                    program[task.at].y = program.size();
+                    break;
+                case Step::PLUS_END: {
+                    Instruction& split = emit(Opcode::SPLIT);
+                    split.x = task.at;
+                    split.y = program.size();
+                    break;
+                }
+                case Step::QUESTION_END: program[task.at].y = program.size(); break;
+                case Step::GROUP_END: emit(Opcode::SAVE).slot = task.at; break;
+                case Step::REPEAT_MEASURED: {
+                    auto repeat_node = std::static_pointer_cast<RepeatAstNode>(task.node);
+                    size_t copy_size = program.size() - task.at;
+                    bool unbounded = repeat_node->max < 0;
+                    size_t copies = unbounded ? repeat_node->min + 1 : repeat_node->max;
+                    if (copy_size * copies > repetition_budget) {
+                        throw std::runtime_error("Repetition " + repeat_node->getLabel() + " needs more than " + std::to_string(repetition_budget) + " instructions");
+                    }
+                    if (repeat_node->min == 0) { // the measured copy is not a mandatory one
+                        program.resize(task.at);
+                    }
+                    // queued in reverse : the mandatory copies, then a star or the optional copies
+                    if (unbounded) {
+                        tasks.push_back({Step::STAR_BEGIN, repeat_node->left});
+                    } else {
+                        // X (X (X)?)? : every split skips straight past all optional copies
+                        optional_splits.emplace_back();
+                        tasks.push_back({Step::REPEAT_END, nullptr});
+                        for (int k = repeat_node->min; k < repeat_node->max; k++) {
+                            tasks.push_back({Step::CODE, repeat_node->left});
+                            tasks.push_back({Step::REPEAT_OPTIONAL, nullptr});
+                        }
+                    }
+                    for (int k = 1; k < repeat_node->min; k++) tasks.push_back({Step::CODE, repeat_node->left});
+                    break;
+                }
+                case Step::REPEAT_OPTIONAL: {
+                    int split = program.size();
+                    optional_splits.back().push_back(split);
+                    emit(Opcode::SPLIT).x = split + 1;
+                    break;
+                }
+                case Step::REPEAT_END:
+                    for (int split : optional_splits.back()) program[split].y = program.size();
+                    optional_splits.pop_back();
+                    break;
+            }
+        }
+    }
+
+    // emit what comes before the operands of node and queue the operands and the steps after them
+    void code(const std::shared_ptr<AstNode>& node, std::vector<Task>& tasks) {
+        if (!node) return;
+
+        if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(node)) {
+            emit(Opcode::CHAR).ch = literal_node->ch;
+            return;
+        }
+
+        if (auto class_node = std::dynamic_pointer_cast<CharClassAstNode>(node)) {
+            emit(Opcode::CLASS).set = classes.size();
+            classes.push_back(class_node->set);
+            return;
+        }
+
+        if (auto code_point_node = std::dynamic_pointer_cast<CodePointClassAstNode>(node)) {
+            std::vector<ByteRangeSequence> sequences;
+            for (const auto& [low, high] : code_point_node->ranges) {
+                for (const auto& sequence : utf8Sequences(low, high)) sequences.push_back(sequence);
+            }
+            std::vector<int> jumps;
+            for (int s = 0; s < sequences.size(); s++) {
+                int split = program.size();
+                if (s + 1 < sequences.size()) emit(Opcode::SPLIT).x = split + 1;
+                for (const auto& [low, high] : sequences[s]) {
+                    emit(Opcode::CLASS).set = classes.size();
+                    classes.push_back(labelCharSet(byteRangeLabel(low, high)));
+                }
+                if (s + 1 < sequences.size()) {
+                    jumps.push_back(program.size());
+                    emit(Opcode::JMP);
+                    program[split].y = program.size();
+                }
+            }
+            for (int jmp : jumps) program[jmp].x = program.size();
+            if (sequences.empty()) { // no code point at all, nothing matches
+                emit(Opcode::CLASS).set = classes.size();
+                classes.push_back(CharSet());
+            }
+            return;
+        }
+
+        if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(node)) {
+            tasks.push_back({Step::CODE, seq_node->right});
+            tasks.push_back({Step::CODE, seq_node->left});
+            return;
+        }
+
+        if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(node)) {
+            int split = program.size();
+            emit(Opcode::SPLIT).x = split + 1;
+            tasks.push_back({Step::OR_BRANCH, node, split});
+            tasks.push_back({Step::CODE, or_node->left});
+            return;
+        }
+
+        if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(node)) {
+            tasks.push_back({Step::STAR_BEGIN, star_node->left});
+            return;
+        }
+
+        if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(node)) {
+            tasks.push_back({Step::PLUS_END, nullptr, (int)program.size()});
+            tasks.push_back({Step::CODE, plus_node->left});
+            return;
+        }
+
+        if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(node)) {
+            int split = program.size();
+            emit(Opcode::SPLIT).x = split + 1;
+            tasks.push_back({Step::QUESTION_END, nullptr, split});
+            tasks.push_back({Step::CODE, question_node->left});
+            return;
+        }
+
+        if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(node)) {
+            emit(Opcode::SAVE).slot = 2 * group_node->index;
+            tasks.push_back({Step::GROUP_END, nullptr, 2 * group_node->index + 1});
+            tasks.push_back({Step::CODE, group_node->left});
+            return;
+        }
+
+        if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(node)) {
+            tasks.push_back({Step::REPEAT_MEASURED, node, (int)program.size()});
+            tasks.push_back({Step::CODE, repeat_node->left});
+            return;
+        }
+
+        throw std::runtime_error("Unknown AST node type");
+    }
+
+    // follow pc at position pos with the slots in scratch, adding every thread it reaches to list
+    void addThread(ThreadList& list, int start_pc, int pos) {
+        int slots = groups * 2;
+        stack.push_back({start_pc, -1, 0});
+        while (!stack.empty()) {
+            Job job = stack.back();
+            stack.pop_back();
+            if (job.slot >= 0) {
+                scratch[job.slot] = job.value;
+                continue;
+            }
+            int pc = job.pc;
+            while (!list.contains(pc)) {
+                list.insert(pc);
+                const Instruction& inst = program[pc];
+                if (inst.op == Opcode::JMP) {
+                    pc = inst.x;
+                } else if (inst.op == Opcode::SPLIT) {
+                    stack.push_back({inst.y, -1, 0});
+                    pc = inst.x;
+                } else if (inst.op == Opcode::SAVE) {
+                    stack.push_back({-1, inst.slot, scratch[inst.slot]});
+                    scratch[inst.slot] = pos;
+                    pc++;
+                } else {
+                    std::copy(scratch.begin(), scratch.end(), list.slots.begin() + (size_t)slot_row[pc] * slots);
+                    break;
+                }
+            }
+        }
+    }
+
+    std::optional<PikeMatch> run(std::string_view input, bool anchored) {
+        int slots = groups * 2;
+        int n = input.size();
+        bool found = false;
+        current.size = 0;
+        for (int i = 0; i <= n; i++) {
+            if (!found && (i == 0 || !anchored)) {
+                std::fill(scratch.begin(), scratch.end(), -1);
+                addThread(current, 0, i);
+            }
+            if (current.size == 0) break;
+
+            next.size = 0;
+            for (int t = 0; t < current.size; t++) {
+                int pc = current.dense[t];
+                const Instruction& inst = program[pc];
+                const int* thread_slots = &current.slots[(size_t)slot_row[pc] * slots];
+                if (inst.op == Opcode::MATCH) {
+                    if (anchored && i < n) continue;
+                    std::copy(thread_slots, thread_slots + slots, matched.begin());
+                    found = true;
+                    break; // the threads after this one have lower priority
+                }
+                if (i == n || (inst.op != Opcode::CHAR && inst.op != Opcode::CLASS)) continue; // end of input, or only a visited mark
+                bool reads = inst.op == Opcode::CHAR ? input[i] == inst.ch : classes[inst.set][(unsigned char)input[i]];
+                if (reads) {
+                    std::copy(thread_slots, thread_slots + slots, scratch.begin());
+                    addThread(next, pc + 1, i + 1);
+                }
+            }
+            std::swap(current, next);
+        }
+        if (!found) return std::nullopt;
+
+        PikeMatch result;
+        for (int g = 0; g < groups; g++) result.groups.push_back({matched[2 * g], matched[2 * g + 1]});
+        return result;
+    }
+};
@@ -0,0 +1,330 @@
+#pragma once
+#include "DFA.hpp"
+#include "pikeVM.hpp"
+#include <cstring>
+
+/**
+ * @brief Literal facts that hold for every string of a sub expression
+ * exact  : the sub expression matches only this one string
+ * prefix : every match starts with it
+ * suffix : every match ends with it
+ * factor : every match contains it, the longest one found is kept
+ */
+
+struct LiteralInfo {
+    std::optional<std::string> exact;
+    std::string prefix;
+    std::string suffix;
+    std::string factor;
+};
+
+std::string commonPrefix(const std::string& a, const std::string& b) {
+    size_t n = 0;
+    while (n < a.size() && n < b.size() && a[n] == b[n]) n++;
+    return a.substr(0, n);
+}
+
+std::string commonSuffix(const std::string& a, const std::string& b) {
+    size_t n = 0;
+    while (n < a.size() && n < b.size() && a[a.size() - 1 - n] == b[b.size() - 1 - n]) n++;
+    return a.substr(a.size() - n);
+}
+
+// longest common substring, both factors are short so the quadratic dp is fine
+std::string commonFactor(const std::string& a, const std::string& b) {
+    std::vector<int> prev(b.size() + 1, 0), curr(b.size() + 1, 0);
+    size_t best = 0, end = 0;
+    for (size_t i = 1; i <= a.size(); i++) {
+        for (size_t j = 1; j <= b.size(); j++) {
+            curr[j] = a[i - 1] == b[j - 1] ? prev[j - 1] + 1 : 0;
+            if (curr[j] > best) {
+                best = curr[j];
+                end = i;
+            }
+        }
+        std::swap(prev, curr);
+    }
+    return a.substr(end - best, best);
+}
+
+void keepLongest(std::string& factor, const std::string& candidate) {
+    if (candidate.size() > factor.size()) factor = candidate;
+}
+
+// longest literal kept, a longer one is no more selective and would make the analysis quadratic
+const size_t LONGEST_LITERAL = 256;
+
+// cut the literals to LONGEST_LITERAL bytes, any part of a required prefix, suffix or factor is still required
+void boundLiterals(LiteralInfo& info) {
+    if (info.exact && info.exact->size() > LONGEST_LITERAL) info.exact.reset();
+    if (info.prefix.size() > LONGEST_LITERAL) info.prefix.resize(LONGEST_LITERAL);
+    if (info.suffix.size() > LONGEST_LITERAL) info.suffix.erase(0, info.suffix.size() - LONGEST_LITERAL);
+    if (info.factor.size() > LONGEST_LITERAL) info.factor.resize(LONGEST_LITERAL);
+}
+
+/**
+ * @brief Extract the required literals of an expression from its AST
+ * Procedure
+ * 1. A literal is exact, it is its own prefix, suffix and factor
+ * 2. SEQ : exact parts glue together, the left prefix grows by an exact left side,
+ *    the right suffix grows by an exact right side and the left suffix followed by
+ *    the right prefix is a factor that crosses the boundary
+ * 3. OR : keep what both sides share, the common prefix, the common suffix and the
+ *    longest common substring of both factors
+ * 4. PLUS : at least one copy, so the prefix, suffix and factor of the operand hold
+ * 5. STAR : may match the empty string, nothing is required
+ * 6. CLASS : a class of one character is that literal, a larger one is unknown
+ * 7. QUESTION : may match the empty string, nothing is required
+ * 8. REPEAT : {0,n} is like STAR, otherwise like PLUS, and an exact operand
+ *    repeated a fixed number of times stays exact while it is short
+ * 9. GROUP : whatever its operand requires
+ * 10. CODE POINT CLASS : one code point is its UTF-8 string, a larger class is unknown
+ * The tree is walked with an explicit stack, the facts of the operands of a node are on
+ * a second stack when it is combined, and every literal is bounded by LONGEST_LITERAL
+ *
+ * @param node
+ * @return LiteralInfo
+ */
+
+LiteralInfo analyzeLiterals(const std::shared_ptr<AstNode>& node) {
+    struct Visit {
+        std::shared_ptr<AstNode> node;
+        bool combine; // the operands are analyzed
+    };
+    std::vector<Visit> visits = {{node, false}};
+    std::vector<LiteralInfo> results;
+    auto popResult = [&]() {
+        LiteralInfo result = std::move(results.back());
+        results.pop_back();
+        return result;
+    };
+
+    while (!visits.empty()) {
+        Visit visit = std::move(visits.back());
+        visits.pop_back();
+        const std::shared_ptr<AstNode>& current = visit.node;
+        LiteralInfo info;
+
+        if (!current) { // epsilon
+            info.exact = "";
+            results.push_back(info);
+            continue;
+        }
+
+        if (!visit.combine) {
+            if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(current)) {
+                info.exact = info.prefix = info.suffix = info.factor = std::string(1, literal_node->ch);
+            } else if (auto class_node = std::dynamic_pointer_cast<CharClassAstNode>(current)) {
+                if (class_node->set.count() == 1) {
+                    info.exact = info.prefix = info.suffix = info.factor = charSetLabel(class_node->set);
+                }
+            } else if (auto code_point_node = std::dynamic_pointer_cast<CodePointClassAstNode>(current)) {
+                const CodePointRanges& ranges = code_point_node->ranges;
+                if (ranges.size() == 1 && ranges[0].first == ranges[0].second) {
+                    info.exact = info.prefix = info.suffix = info.factor = encodeUtf8(ranges[0].first);
+                }
+            } else if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(current)) {
+                visits.push_back({group_node->left, false});
+                continue;
+            } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({seq_node->right, false});
+                visits.push_back({seq_node->left, false});
+                continue;
+            } else if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({or_node->right, false});
+                visits.push_back({or_node->left, false});
+                continue;
+            } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({plus_node->left, false});
+                continue;
+            } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({star_node->left, false});
+                continue;
+            } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({question_node->left, false});
+                continue;
+            } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(current)) {
+                visits.push_back({current, true});
+                visits.push_back({repeat_node->left, false});
+                continue;
+            } else {
+                throw std::runtime_error("Unknown AST node type");
+            }
+            results.push_back(info);
+            continue;
+        }
+
+        if (std::dynamic_pointer_cast<SeqAstNode>(current)) {
+            LiteralInfo right = popResult(), left = popResult();
+            if (left.exact && right.exact) info.exact = *left.exact + *right.exact;
+            info.prefix = left.exact ? *left.exact + right.prefix : left.prefix;
+            info.suffix = right.exact ? left.suffix + *right.exact : right.suffix;
+            keepLongest(info.factor, left.factor);
+            keepLongest(info.factor, right.factor);
+            keepLongest(info.factor, left.suffix + right.prefix);
+            keepLongest(info.factor, info.prefix);
+            keepLongest(info.factor, info.suffix);
+        } else if (std::dynamic_pointer_cast<OrAstNode>(current)) {
+            LiteralInfo right = popResult(), left = popResult();
+            if (left.exact && right.exact && *left.exact == *right.exact) info.exact = left.exact;
+            info.prefix = commonPrefix(left.prefix, right.prefix);
+            info.suffix = commonSuffix(left.suffix, right.suffix);
+            keepLongest(info.factor, commonFactor(left.factor, right.factor));
+            keepLongest(info.factor, info.prefix);
+            keepLongest(info.factor, info.suffix);
+        } else if (std::dynamic_pointer_cast<PlusAstNode>(current)) {
+            LiteralInfo sub = popResult();
+            if (sub.exact && sub.exact->empty()) info.exact = "";
+            info.prefix = sub.prefix;
+            info.suffix = sub.suffix;
+            info.factor = sub.factor;
+        } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(current)) {
+            LiteralInfo sub = popResult();
+            if (sub.exact && sub.exact->empty()) info.exact = "";
+            if (repeat_node->min > 0) {
+                info.prefix = sub.prefix;
+                info.suffix = sub.suffix;
+                info.factor = sub.factor;
+                if (sub.exact && sub.exact->size() * repeat_node->min <= LONGEST_LITERAL) {
+                    std::string repeated;
+                    for (int k = 0; k < repeat_node->min; k++) repeated += *sub.exact;
+                    info.prefix = info.suffix = info.factor = repeated;
+                    if (repeat_node->max == repeat_node->min) info.exact = repeated;
+                }
+            }
+        } else { // star, question
+            LiteralInfo sub = popResult();
+            if (sub.exact && sub.exact->empty()) info.exact = "";
+        }
+        boundLiterals(info);
+        results.push_back(info);
+    }
+    return results.back();
+}
+
+/**
+ * @brief Cheap rejection test placed in front of the DFA
+ * An input that lacks a required literal can not match, so it is rejected
+ * with memcmp/memchr/memmem scans without running the automaton
+ */
+
+class Prefilter {
+public:
+    explicit Prefilter(const std::shared_ptr<AstNode>& ast) : info(analyzeLiterals(ast)) {}
+
+    /**
+     * @brief Whether the whole input may match the expression
+     * the match is anchored at both ends, so prefix and suffix are compared in place
+     *
+     * @param input
+     * @return false if the input certainly does not match
+     */
+
+    bool mayMatch(std::string_view input) {
+        checked++;
+        bool pass;
+        if (info.exact) {
+            pass = input == *info.exact;
+        } else {
+            pass = input.size() >= info.prefix.size() && input.size() >= info.suffix.size()
+                && std::memcmp(input.data(), info.prefix.data(), info.prefix.size()) == 0
+                && std::memcmp(input.data() + input.size() - info.suffix.size(), info.suffix.data(), info.suffix.size()) == 0
+                && contains(input, info.factor);
+        }
+        if (!pass) rejected++;
+        return pass;
+    }
+
+    /**
+     * @brief Whether the input may contain a match somewhere (search mode)
+     * prefix, suffix and factor are all substrings of any match
+     *
+     * @param input
+     * @return false if no substring of the input can match
+     */
+
+    bool mayContainMatch(std::string_view input) {
+        checked++;
+        bool pass = contains(input, info.factor) && contains(input, info.prefix) && contains(input, info.suffix);
+        if (!pass) rejected++;
+        return pass;
+    }
+
+    const LiteralInfo& literals() const {
+        return info;
+    }
+
+    size_t checkedCount() const {
+        return checked;
+    }
+
+    size_t rejectedCount() const {
+        return rejected;
+    }
+
+private:
+    LiteralInfo info;
+    size_t checked = 0;
+    size_t rejected = 0;
+
+    static bool contains(std::string_view input, const std::string& literal) {
+        if (literal.empty()) return true;
+        if (literal.size() == 1) return std::memchr(input.data(), literal[0], input.size()) != nullptr;
+        return memmem(input.data(), input.size(), literal.data(), literal.size()) != nullptr;
+    }
+};
+
+/**
+ * @brief DFA guarded by the prefilter of the expression it was built from
+ */
+
+class PrefilteredDFA {
+public:
+    PrefilteredDFA(const DFA& dfa, const std::shared_ptr<AstNode>& ast) : dfa(dfa), prefilter(ast) {}
+
+    bool match(const std::string& input) {
+        return prefilter.mayMatch(input) && dfa.match(input);
+    }
+
+    const Prefilter& getPrefilter() const {
+        return prefilter;
+    }
+
+private:
+    const DFA& dfa;
+    Prefilter prefilter;
+};
+
+/**
+ * @brief Pike VM guarded by the prefilter of the same expression
+ * search skips the input when it does not contain every required literal, an input
+ * rejected there costs one memchr/memmem pass instead of a run of all the threads
+ */
+
+class PrefilteredPikeVM {
+public:
+    explicit PrefilteredPikeVM(const std::shared_ptr<AstNode>& ast) : vm(ast), prefilter(ast) {}
+
+    std::optional<PikeMatch> match(std::string_view input) {
+        if (!prefilter.mayMatch(input)) return std::nullopt;
+        return vm.match(input);
+    }
+
+    std::optional<PikeMatch> search(std::string_view input) {
+        if (!prefilter.mayContainMatch(input)) return std::nullopt;
+        return vm.search(input);
+    }
+
+    const Prefilter& getPrefilter() const {
+        return prefilter;
+    }
+
+private:
+    PikeVM vm;
+    Prefilter prefilter;
+};
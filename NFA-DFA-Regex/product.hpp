@@ -0,0 +1,322 @@
+#pragma once
+#include "DFA.hpp"
+
+// Boolean operations on DFAs by the product construction
+// Only pairs reachable from the pair of start states are ever explored
+
+enum class BoolOp {
+    INTERSECTION,
+    UNION,
+    DIFFERENCE
+};
+
+// name of the explicit trap state added when a DFA is completed
+const State SINK_STATE = "sink";
+
+bool combine(BoolOp op, bool left, bool right) {
+    if (op == BoolOp::INTERSECTION) return left && right;
+    if (op == BoolOp::UNION) return left || right;
+    return left && !right;
+}
+
+/**
+ * @brief Complete the DFA over the given alphabet
+ * Procedure
+ * 1. Add a non accepting sink state that loops to itself on every symbol
+ * 2. Every missing transition of every state goes to the sink
+ * Class labels are split into atoms together with the labels of the DFA first,
+ * so a class of the alphabet only adds the part the state does not read yet
+ *
+ * @param dfa
+ * @param alphabet
+ * @return DFA
+ */
+
+DFA completeDFA(const DFA& dfa, const std::set<std::string>& alphabet) {
+    DFA::DFATransitionTable states = dfa.getStates();
+    for (const auto& state : dfa.getAcceptingStates()) {
+        states[state]; // accepting states without outgoing transitions
+    }
+    states[dfa.getStartState()];
+    states[SINK_STATE];
+
+    std::set<std::string> labels = dfa.alphabet();
+    labels.insert(alphabet.begin(), alphabet.end());
+    std::set<std::string> atoms;
+    for (const auto& [label, label_atoms] : splitLabels(labels)) {
+        if (alphabet.count(label)) atoms.insert(label_atoms.begin(), label_atoms.end());
+    }
+
+    for (auto& [state, transitions] : states) {
+        for (const auto& atom : atoms) {
+            if (state == SINK_STATE || !dfa.next(state, labelRepresentative(atom))) {
+                transitions[atom] = SINK_STATE;
+            }
+        }
+    }
+
+    DFA complete;
+    complete.setDFA(states, dfa.getStartState(), dfa.getAcceptingStates());
+    return complete;
+}
+
+/**
+ * @brief Complement of the DFA relative to the alphabet
+ * Strings that use a symbol outside the alphabet are rejected by both
+ * the DFA and its complement
+ *
+ * @param dfa
+ * @param alphabet
+ * @return DFA
+ */
+
+DFA complementDFA(const DFA& dfa, const std::set<std::string>& alphabet) {
+    DFA complete = completeDFA(dfa, alphabet);
+    StateSet accepting;
+    for (const auto& [state, transitions] : complete.getStates()) {
+        if (!complete.isAccepting(state)) {
+            accepting.insert(state);
+        }
+    }
+
+    DFA complement;
+    complement.setDFA(complete.getStates(), complete.getStartState(), accepting);
+    return complement;
+}
+
+/**
+ * @brief Materialize the product DFA of a and b
+ * Procedure
+ * 1. Start from the pair of start states
+ * 2. For every unexplored pair and every symbol of either DFA step both sides,
+ *    a missing transition sends that side to the sink
+ * 3. Pairs that can never accept under op are not created
+ * 4. A pair is accepting if op holds on the acceptance of its sides
+ *
+ * @param a
+ * @param b
+ * @param op
+ * @return DFA
+ */
+
+DFA productDFA(const DFA& a, const DFA& b, BoolOp op) {
+    std::set<std::string> labels = a.alphabet();
+    std::set<std::string> b_labels = b.alphabet();
+    labels.insert(b_labels.begin(), b_labels.end());
+    // classes of the two sides may overlap, the product moves on their common atoms
+    std::set<std::string> symbols;
+    for (const auto& [label, atoms] : splitLabels(labels)) symbols.insert(atoms.begin(), atoms.end());
+
+    auto step = [](const DFA& dfa, const State& state, const std::string& symbol) -> State {
+        if (state == SINK_STATE) return SINK_STATE;
+        const State* next = dfa.next(state, labelRepresentative(symbol));
+        return next ? *next : SINK_STATE;
+    };
+    auto accepts = [](const DFA& dfa, const State& state) {
+        return state != SINK_STATE && dfa.isAccepting(state);
+    };
+    // once a side is in the sink its acceptance is fixed to false
+    auto dead = [op](const State& left, const State& right) {
+        bool left_sink = left == SINK_STATE, right_sink = right == SINK_STATE;
+        if (op == BoolOp::INTERSECTION) return left_sink || right_sink;
+        if (op == BoolOp::UNION) return left_sink && right_sink;
+        return left_sink;
+    };
+    auto name = [](const State& left, const State& right) {
+        return "<" + left + "," + right + ">";
+    };
+
+    DFA::DFATransitionTable states;
+    StateSet accepting;
+    State start = name(a.getStartState(), b.getStartState());
+
+    std::set<std::pair<State, State>> visited = {{a.getStartState(), b.getStartState()}};
+    std::queue<std::pair<State, State>> unexplored;
+    unexplored.push({a.getStartState(), b.getStartState()});
+    states[start];
+
+    while (!unexplored.empty()) {
+        auto [left, right] = unexplored.front();
+        unexplored.pop();
+        State current = name(left, right);
+        if (combine(op, accepts(a, left), accepts(b, right))) {
+            accepting.insert(current);
+        }
+
+        for (const auto& symbol : symbols) {
+            State next_left = step(a, left, symbol);
+            State next_right = step(b, right, symbol);
+            if (dead(next_left, next_right)) continue;
+
+            states[current][symbol] = name(next_left, next_right);
+            if (visited.insert({next_left, next_right}).second) {
+                states[name(next_left, next_right)];
+                unexplored.push({next_left, next_right});
+            }
+        }
+    }
+
+    DFA product;
+    product.setDFA(states, start, accepting);
+    return product;
+}
+
+/**
+ * @brief Product of any number of DFAs that is explored while matching
+ * The component DFAs are renumbered once, product states are interned the
+ * first time an input reaches them and their transitions are cached, so a
+ * boolean combination of rules is decided in a single pass over the input
+ *
+ * accept receives the acceptance of every component, e.g.
+ * [](const std::vector<bool>& m) { return m[0] && m[1] && !m[2]; }
+ */
+
+class LazyProductDFA {
+public:
+    using AcceptFunction = std::function<bool(const std::vector<bool>&)>;
+
+    LazyProductDFA(const std::vector<const DFA*>& dfas, AcceptFunction accept) : accept(accept) {
+        for (const DFA* dfa : dfas) {
+            addComponent(*dfa);
+        }
+        std::vector<int> start;
+        for (const auto& component : components) {
+            start.push_back(component.start);
+        }
+        start_state = intern(start);
+    }
+
+    LazyProductDFA(const DFA& a, const DFA& b, BoolOp op)
+        : LazyProductDFA({&a, &b}, [op](const std::vector<bool>& m) { return combine(op, m[0], m[1]); }) {}
+
+    bool match(const std::string& input) {
+        int current = start_state;
+        for (const char& symbol : input) {
+            if (dead[current]) return false;
+            auto it = transitions[current].find(symbol);
+            if (it != transitions[current].end()) {
+                current = it->second;
+                continue;
+            }
+            int next = step(current, symbol); // may intern new states
+            transitions[current][symbol] = next;
+            current = next;
+        }
+        return accepting[current];
+    }
+
+    // number of product states interned so far
+    size_t exploredStates() const {
+        return tuples.size();
+    }
+
+private:
+    // component DFA renumbered to integers, -1 is the sink
+    struct Component {
+        std::vector<std::unordered_map<char, int>> delta;
+        std::vector<bool> accepting;
+        int start;
+    };
+
+    std::vector<Component> components;
+    AcceptFunction accept;
+    std::map<std::vector<int>, int> tupleToState;
+    std::vector<std::vector<int>> tuples;
+    std::vector<std::unordered_map<char, int>> transitions;
+    std::vector<bool> accepting;
+    std::vector<bool> dead;
+    int start_state;
+
+    void addComponent(const DFA& dfa) {
+        std::unordered_map<State, int> number;
+        auto id = [&](const State& state) {
+            auto it = number.find(state);
+            if (it != number.end()) return it->second;
+            int next = number.size();
+            number[state] = next;
+            return next;
+        };
+
+        Component component;
+        component.start = id(dfa.getStartState());
+        for (const auto& [state, next_states] : dfa.getStates()) {
+            id(state);
+            for (const auto& [symbol, next_state] : next_states) id(next_state);
+        }
+        component.delta.resize(number.size());
+        component.accepting.resize(number.size());
+        for (const auto& [state, index] : number) {
+            component.accepting[index] = dfa.isAccepting(state);
+        }
+        for (const auto& [state, next_states] : dfa.getStates()) {
+            for (const auto& [symbol, next_state] : next_states) {
+                if (symbol.size() == 1) {
+                    component.delta[number[state]][symbol[0]] = number[next_state];
+                    continue;
+                }
+                CharSet set = labelCharSet(symbol);
+                for (int c = 0; c < 256; c++) {
+                    if (set[c]) component.delta[number[state]][char(c)] = number[next_state];
+                }
+            }
+        }
+        components.push_back(component);
+    }
+
+    int intern(const std::vector<int>& tuple) {
+        auto it = tupleToState.find(tuple);
+        if (it != tupleToState.end()) return it->second;
+
+        int state = tuples.size();
+        tupleToState[tuple] = state;
+        tuples.push_back(tuple);
+        transitions.emplace_back();
+
+        std::vector<bool> marks(tuple.size());
+        for (int i = 0; i < tuple.size(); i++) {
+            marks[i] = tuple[i] >= 0 && components[i].accepting[tuple[i]];
+        }
+        accepting.push_back(accept(marks));
+        dead.push_back(!accepting.back() && rejectsForever(tuple));
+        return state;
+    }
+
+    /**
+     * @brief Whether no continuation of the input can make the combination accept
+     * A trapped component rejects from now on, the others may still end either way,
+     * so the state is dead when accept is false for every setting of the live ones
+     * This is a bounded heuristic : beyond MAX_LIVE live components the settings are
+     * not enumerated and the state is never marked dead, matching then simply runs
+     * to the end of the input
+     *
+     * @param tuple
+     * @return true
+     * @return false
+     */
+
+    bool rejectsForever(const std::vector<int>& tuple) const {
+        static constexpr int MAX_LIVE = 16;
+        std::vector<int> live;
+        for (int i = 0; i < tuple.size(); i++) {
+            if (tuple[i] >= 0) live.push_back(i);
+        }
+        if (live.size() > MAX_LIVE) return false;
+        std::vector<bool> marks(tuple.size(), false);
+        for (uint32_t setting = 0; setting < (1u << live.size()); setting++) {
+            for (int k = 0; k < live.size(); k++) marks[live[k]] = setting >> k & 1;
+            if (accept(marks)) return false;
+        }
+        return true;
+    }
+
+    int step(int state, char symbol) {
+        std::vector<int> next = tuples[state];
+        for (int i = 0; i < next.size(); i++) {
+            if (next[i] < 0) continue;
+            const auto& delta = components[i].delta[next[i]];
+            auto it = delta.find(symbol);
+            next[i] = it == delta.end() ? -1 : it->second;
+        }
+        return intern(next);
+    }
+};
@@ -0,0 +1,438 @@
+#pragma once
+#include "parseRegX.hpp"
+
+// Algebraic rewrites of the regex AST, applied before the NFA is built
+// The language never changes, only the size of the tree and so of the automata
+
+// Every walk over the tree keeps its own stack, a pattern may nest a million levels deep
+
+// the branches of a chain of OR nodes, left to right
+void flattenOr(const std::shared_ptr<AstNode>& node, std::vector<std::shared_ptr<AstNode>>& branches) {
+    std::vector<std::shared_ptr<AstNode>> stack = {node};
+    while (!stack.empty()) {
+        std::shared_ptr<AstNode> top = std::move(stack.back());
+        stack.pop_back();
+        if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(top)) {
+            stack.push_back(or_node->right);
+            stack.push_back(or_node->left);
+        } else {
+            branches.push_back(top);
+        }
+    }
+}
+
+size_t countAstNodes(const std::shared_ptr<AstNode>& node) {
+    size_t count = 0;
+    std::vector<std::shared_ptr<AstNode>> stack = {node};
+    while (!stack.empty()) {
+        std::shared_ptr<AstNode> top = std::move(stack.back());
+        stack.pop_back();
+        if (!top) continue;
+        count++;
+        if (auto or_node = std::dynamic_pointer_cast<OrAstNode>(top)) {
+            stack.push_back(or_node->left);
+            stack.push_back(or_node->right);
+        } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(top)) {
+            stack.push_back(seq_node->left);
+            stack.push_back(seq_node->right);
+        } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(top)) {
+            stack.push_back(star_node->left);
+        } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(top)) {
+            stack.push_back(plus_node->left);
+        } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(top)) {
+            stack.push_back(question_node->left);
+        } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(top)) {
+            stack.push_back(repeat_node->left);
+        } else if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(top)) {
+            stack.push_back(group_node->left);
+        }
+    }
+    return count;
+}
+
+// a literal character as a regex reads it, bytes that are not printable as \xNN
+std::string literalString(char c) {
+    if (c != '\0' && std::strchr("|*+()?.[]{}\\", c)) return "\\" + std::string(1, c);
+    if (c == '\n') return "\\n";
+    if (c == '\t') return "\\t";
+    if (c == '\r') return "\\r";
+    if (!std::isprint((unsigned char)c)) return printableByte(c);
+    return std::string(1, c);
+}
+
+/**
+ * @brief The AST written back as a regex that lexer and ParseRegex read again
+ * Equal sub expressions give equal strings, so it also serves as a structural key
+ * Procedure, the text is written left to right from a stack of pieces, a piece is
+ * a node still to write or a text ("(", "|", ")", "*", ...) that follows it
+ * 1. literal, class : its own text
+ * 2. seq : left then right
+ * 3. or : the flattened branches in parentheses separated by '|'
+ * 4. star, plus, question, repeat : the operand, in parentheses unless it is a single
+ *    character, an alternation or a group, then the operator
+ * 5. group : the operand in parentheses, an alternation already has them
+ *
+ * @param node
+ * @return std::string
+ */
+
+std::string regexString(const std::shared_ptr<AstNode>& node) {
+    struct Piece {
+        std::shared_ptr<AstNode> node;
+        std::string text; // written as is when node is not set
+    };
+    std::string regex;
+    std::vector<Piece> pieces = {{node, ""}};
+    auto pushText = [&](const std::string& text) { pieces.push_back({nullptr, text}); };
+    auto pushAtomic = [&](const std::shared_ptr<AstNode>& operand, const std::string& op) {
+        bool single = std::dynamic_pointer_cast<LiteralCharacterAstNode>(operand) || std::dynamic_pointer_cast<CharClassAstNode>(operand) ||
+                      std::dynamic_pointer_cast<CodePointClassAstNode>(operand) ||
+                      std::dynamic_pointer_cast<OrAstNode>(operand) || std::dynamic_pointer_cast<GroupAstNode>(operand);
+        pushText(single ? op : ")" + op);
+        pieces.push_back({operand, ""});
+        if (!single) pushText("(");
+    };
+
+    while (!pieces.empty()) {
+        Piece piece = std::move(pieces.back());
+        pieces.pop_back();
+        const std::shared_ptr<AstNode>& current = piece.node;
+        if (!current) {
+            regex += piece.text;
+        } else if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(current)) {
+            regex += literalString(literal_node->ch);
+        } else if (auto code_point_node = std::dynamic_pointer_cast<CodePointClassAstNode>(current)) {
+            const CodePointRanges& ranges = code_point_node->ranges;
+            bool ascii = ranges.size() == 1 && ranges[0].first == ranges[0].second && ranges[0].first < 0x80;
+            regex += ascii ? literalString(char(ranges[0].first)) : code_point_node->getLabel(); // the label does not escape | * + ...
+        } else if (auto class_node = std::dynamic_pointer_cast<CharClassAstNode>(current)) {
+            regex += class_node->set.count() == 1 ? literalString(charSetLabel(class_node->set)[0]) : printableLabel(charSetLabel(class_node->set));
+        } else if (std::dynamic_pointer_cast<OrAstNode>(current)) {
+            std::vector<std::shared_ptr<AstNode>> branches;
+            flattenOr(current, branches);
+            pushText(")");
+            for (size_t b = branches.size(); b-- > 0;) {
+                pieces.push_back({branches[b], ""});
+                pushText(b == 0 ? "(" : "|");
+            }
+        } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(current)) {
+            pieces.push_back({seq_node->right, ""});
+            pieces.push_back({seq_node->left, ""});
+        } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(current)) {
+            pushAtomic(star_node->left, "*");
+        } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(current)) {
+            pushAtomic(plus_node->left, "+");
+        } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(current)) {
+            pushAtomic(question_node->left, "?");
+        } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(current)) {
+            pushAtomic(repeat_node->left, repeat_node->getLabel());
+        } else if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(current)) {
+            bool parenthesized = std::dynamic_pointer_cast<OrAstNode>(group_node->left) != nullptr; // an alternation already has them
+            if (!parenthesized) pushText(")");
+            pieces.push_back({group_node->left, ""});
+            if (!parenthesized) pushText("(");
+        } else {
+            throw std::runtime_error("Unknown AST node type");
+        }
+    }
+    return regex;
+}
+
+// the operands of a chain of SEQ nodes, left to right
+void flattenSeq(const std::shared_ptr<AstNode>& node, std::vector<std::shared_ptr<AstNode>>& factors) {
+    std::vector<std::shared_ptr<AstNode>> stack = {node};
+    while (!stack.empty()) {
+        std::shared_ptr<AstNode> top = std::move(stack.back());
+        stack.pop_back();
+        if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(top)) {
+            stack.push_back(seq_node->right);
+            stack.push_back(seq_node->left);
+        } else if (top) {
+            factors.push_back(top);
+        }
+    }
+}
+
+std::shared_ptr<AstNode> buildSeq(const std::vector<std::shared_ptr<AstNode>>& factors, size_t from, size_t to) {
+    std::shared_ptr<AstNode> ast;
+    for (size_t i = from; i < to; i++) {
+        ast = ast ? std::make_shared<SeqAstNode>(ast, factors[i]) : factors[i];
+    }
+    return ast;
+}
+
+std::shared_ptr<AstNode> buildOr(const std::vector<std::shared_ptr<AstNode>>& branches) {
+    std::shared_ptr<AstNode> ast;
+    for (const auto& branch : branches) {
+        ast = ast ? std::make_shared<OrAstNode>(ast, branch) : branch;
+    }
+    return ast;
+}
+
+// x* x+ x? of an already simplified operand, nested closures collapse into one
+std::shared_ptr<AstNode> simplifiedStar(const std::shared_ptr<AstNode>& sub) {
+    std::shared_ptr<AstNode> inner = sub;
+    while (true) {
+        if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(inner)) inner = star_node->left;
+        else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(inner)) inner = plus_node->left;
+        else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(inner)) inner = question_node->left;
+        else break;
+    }
+    return std::make_shared<StarAstNode>(inner);
+}
+
+std::shared_ptr<AstNode> simplifiedPlus(const std::shared_ptr<AstNode>& sub) {
+    if (std::dynamic_pointer_cast<StarAstNode>(sub) || std::dynamic_pointer_cast<PlusAstNode>(sub)) return sub;
+    if (std::dynamic_pointer_cast<QuestionAstNode>(sub)) return simplifiedStar(sub);
+    return std::make_shared<PlusAstNode>(sub);
+}
+
+std::shared_ptr<AstNode> simplifiedQuestion(const std::shared_ptr<AstNode>& sub) {
+    if (std::dynamic_pointer_cast<StarAstNode>(sub) || std::dynamic_pointer_cast<QuestionAstNode>(sub)) return sub;
+    if (std::dynamic_pointer_cast<PlusAstNode>(sub)) return simplifiedStar(sub);
+    return std::make_shared<QuestionAstNode>(sub);
+}
+
+std::shared_ptr<AstNode> simplifyAlternation(std::vector<std::shared_ptr<AstNode>> branches);
+
+/**
+ * @brief Factor the branches that share their first (or last) factor
+ * P R1 | P R2 becomes P (R1 | R2) with the longest common P of the group,
+ * a branch that is all prefix leaves an empty rest, the rest is then optional
+ *
+ * @param sequences every branch as its list of factors
+ * @param from_end factor common suffixes instead of prefixes
+ * @return std::vector<std::shared_ptr<AstNode>> the branches after factoring
+ */
+
+std::vector<std::shared_ptr<AstNode>> factorBranches(const std::vector<std::vector<std::shared_ptr<AstNode>>>& sequences, bool from_end) {
+    auto factorAt = [&](const std::vector<std::shared_ptr<AstNode>>& sequence, size_t k) {
+        return regexString(from_end ? sequence[sequence.size() - 1 - k] : sequence[k]);
+    };
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<int>> groups;
+    for (int b = 0; b < sequences.size(); b++) {
+        std::string key = factorAt(sequences[b], 0);
+        if (!groups.count(key)) order.push_back(key);
+        groups[key].push_back(b);
+    }
+
+    std::vector<std::shared_ptr<AstNode>> branches;
+    for (const auto& key : order) {
+        const std::vector<int>& group = groups[key];
+        const auto& first = sequences[group[0]];
+        if (group.size() == 1) {
+            branches.push_back(buildSeq(first, 0, first.size()));
+            continue;
+        }
+        size_t common = 1;
+        while (true) {
+            bool shared = true;
+            for (int b : group) shared = shared && common < sequences[b].size();
+            if (!shared) break;
+            std::string next = factorAt(first, common);
+            for (int b : group) shared = shared && factorAt(sequences[b], common) == next;
+            if (!shared) break;
+            common++;
+        }
+
+        bool optional = false;
+        std::vector<std::shared_ptr<AstNode>> rests;
+        for (int b : group) {
+            const auto& sequence = sequences[b];
+            if (sequence.size() == common) {
+                optional = true;
+                continue;
+            }
+            rests.push_back(from_end ? buildSeq(sequence, 0, sequence.size() - common) : buildSeq(sequence, common, sequence.size()));
+        }
+        std::shared_ptr<AstNode> rest = rests.empty() ? nullptr : simplifyAlternation(rests);
+        if (rest && optional) rest = simplifiedQuestion(rest);
+
+        std::vector<std::shared_ptr<AstNode>> factors;
+        if (from_end) {
+            if (rest) factors.push_back(rest);
+            factors.insert(factors.end(), first.end() - common, first.end());
+        } else {
+            factors.insert(factors.end(), first.begin(), first.begin() + common);
+            if (rest) factors.push_back(rest);
+        }
+        branches.push_back(buildSeq(factors, 0, factors.size()));
+    }
+    return branches;
+}
+
+/**
+ * @brief Simplify an alternation given as its already simplified branches
+ * Procedure
+ * 1. Structurally equal branches are kept once
+ * 2. Branches with a common prefix are factored, then those with a common suffix
+ * 3. Branches that read one character (literals and classes) merge into one class,
+ *    code point classes of a UTF-8 pattern into one code point class
+ * 4. An empty branch makes the rest optional
+ * Factoring simplifies the rests of a group as an alternation again. Every level splits
+ * its group, and the branches left behind at level k are at least k factors long, so d
+ * levels need about d^2 / 2 factors and the depth stays below the square root of the size
+ */
+
+std::shared_ptr<AstNode> simplifyAlternation(std::vector<std::shared_ptr<AstNode>> branches) {
+    bool has_empty = false;
+    std::vector<std::shared_ptr<AstNode>> unique;
+    std::set<std::string> seen;
+    for (const auto& branch : branches) {
+        if (!branch) {
+            has_empty = true;
+        } else if (seen.insert(regexString(branch)).second) {
+            unique.push_back(branch);
+        }
+    }
+
+    std::vector<std::shared_ptr<AstNode>> factored = unique;
+    if (factored.size() > 1) {
+        std::vector<std::vector<std::shared_ptr<AstNode>>> sequences(factored.size());
+        for (int b = 0; b < factored.size(); b++) flattenSeq(factored[b], sequences[b]);
+        factored = factorBranches(sequences, false);
+    }
+    if (factored.size() > 1) {
+        std::vector<std::vector<std::shared_ptr<AstNode>>> sequences(factored.size());
+        for (int b = 0; b < factored.size(); b++) flattenSeq(factored[b], sequences[b]);
+        factored = factorBranches(sequences, true);
+    }
+
+    CharSet merged;
+    CodePointRanges merged_code_points;
+    int single = 0, merged_at = -1, code_point_classes = 0, code_points_at = -1;
+    std::vector<std::shared_ptr<AstNode>> kept;
+    for (const auto& branch : factored) {
+        if (auto code_point_node = std::dynamic_pointer_cast<CodePointClassAstNode>(branch)) {
+            merged_code_points.insert(merged_code_points.end(), code_point_node->ranges.begin(), code_point_node->ranges.end());
+            if (code_point_classes++ == 0) {
+                code_points_at = kept.size();
+                kept.push_back(branch);
+            }
+            continue;
+        }
+        if (auto literal_node = std::dynamic_pointer_cast<LiteralCharacterAstNode>(branch)) {
+            merged.set((unsigned char)literal_node->ch);
+        } else if (auto class_node = std::dynamic_pointer_cast<CharClassAstNode>(branch)) {
+            merged |= class_node->set;
+        } else {
+            kept.push_back(branch);
+            continue;
+        }
+        if (single++ == 0) {
+            merged_at = kept.size();
+            kept.push_back(branch);
+        }
+    }
+    if (single > 1) {
+        kept[merged_at] = merged.count() == 1 ? std::shared_ptr<AstNode>(std::make_shared<LiteralCharacterAstNode>(charSetLabel(merged)[0]))
+                                              : std::make_shared<CharClassAstNode>(merged);
+    }
+    if (code_point_classes > 1) kept[code_points_at] = std::make_shared<CodePointClassAstNode>(normalizeRanges(merged_code_points));
+
+    std::shared_ptr<AstNode> ast = buildOr(kept);
+    if (ast && has_empty) ast = simplifiedQuestion(ast);
+    return ast;
+}
+
+/**
+ * @brief Rewrite the AST bottom up into a smaller equivalent one
+ * Procedure
+ * 1. (x*)* (x+)* (x?)* (x*)+ (x+)? ... collapse to a single x*, x+ or x?
+ * 2. x{1} is x, x{0,} x{1,} x{0,1} are x* x+ x?
+ * 3. alternations are flattened and go through simplifyAlternation
+ * Capture groups are dropped, the result is meant for the automata that report no submatches
+ * The tree is walked with an explicit stack, every operand is simplified before its node
+ *
+ * @param node
+ * @return std::shared_ptr<AstNode>
+ */
+
+std::shared_ptr<AstNode> simplifyRegex(const std::shared_ptr<AstNode>& node) {
+    // a node is entered, its operands are simplified onto results, then it is assembled from them
+    struct Visit {
+        std::shared_ptr<AstNode> node;
+        bool assemble;
+        size_t operands;
+    };
+    std::vector<Visit> visits = {{node, false, 0}};
+    std::vector<std::shared_ptr<AstNode>> results;
+    auto popResult = [&]() {
+        std::shared_ptr<AstNode> result = std::move(results.back());
+        results.pop_back();
+        return result;
+    };
+
+    while (!visits.empty()) {
+        Visit visit = std::move(visits.back());
+        visits.pop_back();
+        const std::shared_ptr<AstNode>& current = visit.node;
+
+        if (!visit.assemble) {
+            if (!current || std::dynamic_pointer_cast<LiteralCharacterAstNode>(current) || std::dynamic_pointer_cast<CharClassAstNode>(current) ||
+                std::dynamic_pointer_cast<CodePointClassAstNode>(current)) {
+                results.push_back(current);
+            } else if (auto group_node = std::dynamic_pointer_cast<GroupAstNode>(current)) {
+                visits.push_back({group_node->left, false, 0});
+            } else if (std::dynamic_pointer_cast<OrAstNode>(current)) {
+                std::vector<std::shared_ptr<AstNode>> branches;
+                flattenOr(current, branches);
+                visits.push_back({current, true, branches.size()});
+                for (size_t b = branches.size(); b-- > 0;) visits.push_back({branches[b], false, 0});
+            } else if (auto seq_node = std::dynamic_pointer_cast<SeqAstNode>(current)) {
+                visits.push_back({current, true, 2});
+                visits.push_back({seq_node->right, false, 0});
+                visits.push_back({seq_node->left, false, 0});
+            } else if (auto star_node = std::dynamic_pointer_cast<StarAstNode>(current)) {
+                visits.push_back({current, true, 1});
+                visits.push_back({star_node->left, false, 0});
+            } else if (auto plus_node = std::dynamic_pointer_cast<PlusAstNode>(current)) {
+                visits.push_back({current, true, 1});
+                visits.push_back({plus_node->left, false, 0});
+            } else if (auto question_node = std::dynamic_pointer_cast<QuestionAstNode>(current)) {
+                visits.push_back({current, true, 1});
+                visits.push_back({question_node->left, false, 0});
+            } else if (auto repeat_node = std::dynamic_pointer_cast<RepeatAstNode>(current)) {
+                visits.push_back({current, true, 1});
+                visits.push_back({repeat_node->left, false, 0});
+            } else {
+                throw std::runtime_error("Unknown AST node type");
+            }
+            continue;
+        }
+
+        if (std::dynamic_pointer_cast<OrAstNode>(current)) {
+            std::vector<std::shared_ptr<AstNode>> branches(results.end() - visit.operands, results.end());
+            results.resize(results.size() - visit.operands);
+            results.push_back(simplifyAlternation(branches));
+            continue;
+        }
+        if (std::dynamic_pointer_cast<SeqAstNode>(current)) {
+            std::shared_ptr<AstNode> right = popResult(), left = popResult();
+            if (!left || !right) results.push_back(left ? left : right);
+            else results.push_back(std::make_shared<SeqAstNode>(left, right));
+            continue;
+        }
+
+        std::shared_ptr<AstNode> sub = popResult();
+        if (!sub) {
+            results.push_back(current);
+        } else if (std::dynamic_pointer_cast<StarAstNode>(current)) {
+            results.push_back(simplifiedStar(sub));
+        } else if (std::dynamic_pointer_cast<PlusAstNode>(current)) {
+            results.push_back(simplifiedPlus(sub));
+        } else if (std::dynamic_pointer_cast<QuestionAstNode>(current)) {
+            results.push_back(simplifiedQuestion(sub));
+        } else {
+            auto repeat_node = std::static_pointer_cast<RepeatAstNode>(current);
+            int min = repeat_node->min, max = repeat_node->max;
+            if (min == 1 && max == 1) results.push_back(sub);
+            else if (min == 0 && max < 0) results.push_back(simplifiedStar(sub));
+            else if (min == 1 && max < 0) results.push_back(simplifiedPlus(sub));
+            else if (min == 0 && max == 1) results.push_back(simplifiedQuestion(sub));
+            else results.push_back(std::make_shared<RepeatAstNode>(sub, min, max));
+        }
+    }
+    return results.back();
+}
@@ -0,0 +1,311 @@
+#pragma once
+#include "NFA.hpp"
+
+// one rule of a tokenizer, earlier rules win ties between matches of the same length
+struct TokenRule {
+    std::string name;
+    std::string regex;
+};
+
+// a token of the input, kind is the index of its rule or Tokenizer::NO_RULE
+struct Lexeme {
+    int kind;
+    size_t offset;
+    size_t length;
+};
+
+/**
+ * @brief Flex style maximal munch tokenizer
+ * The NFAs of all rules hang off one start state and a single DFA is built from them,
+ * every DFA state is tagged with the first rule whose final state it contains. Scanning
+ * follows the DFA as far as it goes and cuts the token at the last accepting state seen,
+ * a byte where no rule matches becomes a one byte NO_RULE token
+ */
+
+class Tokenizer {
+public:
+    static constexpr int NO_RULE = -1;
+
+    explicit Tokenizer(const std::vector<TokenRule>& rules) : rules(rules) {
+        if (rules.empty()) {
+            throw std::runtime_error("Tokenizer needs at least one rule");
+        }
+        buildDFA();
+        minimize();
+        if (accept[start_state] != NO_RULE) {
+            throw std::runtime_error("Rule " + rules[accept[start_state]].name + " matches the empty string");
+        }
+    }
+
+    std::vector<Lexeme> tokenize(const std::string& input) const {
+        std::vector<Lexeme> tokens;
+        scan(input.data(), input.size(), true, 0, [&](const Lexeme& token) { tokens.push_back(token); });
+        return tokens;
+    }
+
+    /**
+     * @brief Tokenize a stream block by block
+     * A token still growing at the end of the buffer is kept and scanned again once
+     * more input is read, the read size doubles with the kept part so a long token
+     * costs linear time overall
+     *
+     * @param in
+     * @param emit called with every token in order, offsets count from the start of the stream
+     * @param block_size bytes read at a time
+     */
+
+    void tokenize(std::istream& in, const std::function<void(const Lexeme&)>& emit, size_t block_size = 1 << 16) const {
+        std::string buffer;
+        size_t base = 0;
+        bool final = false;
+        while (!final) {
+            size_t kept = buffer.size();
+            size_t wanted = std::max(block_size, kept);
+            buffer.resize(kept + wanted);
+            in.read(&buffer[kept], wanted);
+            buffer.resize(kept + in.gcount());
+            final = !in;
+            size_t consumed = scan(buffer.data(), buffer.size(), final, base, emit);
+            buffer.erase(0, consumed);
+            base += consumed;
+        }
+    }
+
+    const std::string& ruleName(int kind) const {
+        static const std::string no_rule = "NO_RULE";
+        return kind == NO_RULE ? no_rule : rules.at(kind).name;
+    }
+
+    int numStates() const {
+        return accept.size();
+    }
+
+    int numClasses() const {
+        return num_classes;
+    }
+
+private:
+    std::vector<TokenRule> rules;
+    std::array<uint8_t, 256> byte_class{};
+    int num_classes = 1;
+    std::vector<int32_t> table;
+    std::vector<int> accept; // rule of each state, NO_RULE if it does not accept
+    int start_state = 0;
+    int dead_state = 0;
+
+    /**
+     * @brief Scan tokens from data
+     * Procedure
+     * 1. From the start of the token follow the DFA until the dead state or the end,
+     *    remembering the last accepting state and the position after it
+     * 2. The token ends there, an input with no accepting state gives one NO_RULE byte
+     * 3. The states passed after the last accept lead to no accept, each (position, state)
+     *    is recorded as failed, a later token entering one stops at once (Reps), so no
+     *    stretch of input is scanned again from the same state and the scan stays linear
+     * 4. If the buffer is not final a token reaching its end might grow, it is left for later
+     *
+     * @param data
+     * @param size
+     * @param final no input follows data
+     * @param base offset of data[0] in the whole input
+     * @param emit
+     * @return size_t bytes consumed by the emitted tokens
+     */
+
+    template <class Emit>
+    size_t scan(const char* data, size_t size, bool final, size_t base, Emit&& emit) const {
+        std::unordered_set<uint64_t> failed;
+        size_t failed_end = 0; // every failed pair has a position <= failed_end
+        std::vector<int> trail;
+        size_t pos = 0;
+        while (pos < size) {
+            if (!failed.empty() && pos >= failed_end) failed = std::unordered_set<uint64_t>();
+            int state = start_state, rule = NO_RULE;
+            size_t i = pos, end = pos;
+            size_t memo_end = failed.empty() ? 0 : failed_end;
+            bool blocked = false;
+            trail.clear();
+            while (i < size) {
+                state = table[state * num_classes + byte_class[(unsigned char)data[i]]];
+                i++;
+                if (state == dead_state || (i <= memo_end && failed.count(uint64_t(i) * accept.size() + state))) {
+                    blocked = true;
+                    break;
+                }
+                if (accept[state] != NO_RULE) {
+                    rule = accept[state];
+                    end = i;
+                    trail.clear();
+                } else {
+                    trail.push_back(state);
+                }
+            }
+            if (!blocked && !final) return pos;
+            for (size_t k = 0; k < trail.size(); k++) {
+                failed.insert(uint64_t(end + 1 + k) * accept.size() + trail[k]);
+            }
+            failed_end = std::max(failed_end, end + trail.size());
+            if (rule == NO_RULE) end = pos + 1;
+            emit(Lexeme{rule, base + pos, end - pos});
+            pos = end;
+        }
+        return pos;
+    }
+
+    /**
+     * @brief Subset construction over the NFAs of all rules
+     * Procedure
+     * 1. Build the NFA of every rule and join them by epsilon edges from a new start state
+     * 2. Split all labels into disjoint atoms, each atom is a byte class, bytes on no edge
+     *    share one more class that always leads to the dead state
+     * 3. Number the NFA states and run the subset construction with integer sets,
+     *    the empty set is the dead state
+     * 4. A DFA state accepts for the smallest rule index among its final NFA states
+     */
+
+    void buildDFA() {
+        TransitionTable combined;
+        std::unordered_map<State, int> final_rule;
+        State start = generateState();
+        for (int r = 0; r < rules.size(); r++) {
+            NFA nfa(ParseRegex(lexer(rules[r].regex)).parse());
+            for (const auto& [state, transitions] : nfa.getStates()) combined[state] = transitions;
+            combined[start][""].insert(nfa.getStartState());
+            final_rule.emplace(nfa.getFinalState(), r);
+        }
+
+        std::set<std::string> labels;
+        for (const auto& [state, transitions] : combined) {
+            for (const auto& [symbol, next_states] : transitions) {
+                if (symbol != "") labels.insert(symbol);
+            }
+        }
+        std::map<std::string, std::vector<std::string>> atoms = splitLabels(labels);
+        std::map<std::string, int> atom_class;
+        for (const auto& [label, label_atoms] : atoms) {
+            for (const auto& atom : label_atoms) atom_class.emplace(atom, 0);
+        }
+        num_classes = 0;
+        for (auto& [atom, cls] : atom_class) cls = num_classes++;
+        byte_class.fill(num_classes);
+        for (const auto& [atom, cls] : atom_class) {
+            CharSet set = labelCharSet(atom);
+            for (int byte = 0; byte < 256; byte++) {
+                if (set[byte]) byte_class[byte] = cls;
+            }
+        }
+        num_classes++;
+
+        std::unordered_map<State, int> number;
+        auto numberOf = [&](const State& state) {
+            return number.emplace(state, number.size()).first->second;
+        };
+        numberOf(start);
+        for (const auto& [state, transitions] : combined) {
+            numberOf(state);
+            for (const auto& [symbol, next_states] : transitions) {
+                for (const auto& next_state : next_states) numberOf(next_state);
+            }
+        }
+        int n = number.size();
+        std::vector<std::vector<int>> epsilon(n);
+        std::vector<std::vector<std::pair<int, int>>> moves(n); // (class, target)
+        std::vector<int> rule_of(n, NO_RULE);
+        for (const auto& [state, rule] : final_rule) rule_of[number[state]] = rule;
+        for (const auto& [state, transitions] : combined) {
+            int from = number[state];
+            for (const auto& [symbol, next_states] : transitions) {
+                for (const auto& next_state : next_states) {
+                    if (symbol == "") {
+                        epsilon[from].push_back(number[next_state]);
+                        continue;
+                    }
+                    for (const auto& atom : atoms.at(symbol)) moves[from].push_back({atom_class[atom], number[next_state]});
+                }
+            }
+        }
+
+        std::vector<int> seen(n, -1);
+        int stamp = 0;
+        auto closure = [&](std::vector<int> set) {
+            stamp++;
+            std::vector<int> stack = set;
+            set.clear();
+            while (!stack.empty()) {
+                int s = stack.back();
+                stack.pop_back();
+                if (seen[s] == stamp) continue;
+                seen[s] = stamp;
+                set.push_back(s);
+                for (int t : epsilon[s]) stack.push_back(t);
+            }
+            std::sort(set.begin(), set.end());
+            return set;
+        };
+
+        std::map<std::vector<int>, int> dfa_state;
+        std::vector<std::vector<int>> subsets;
+        auto stateOf = [&](const std::vector<int>& set) {
+            auto [it, inserted] = dfa_state.emplace(set, subsets.size());
+            if (inserted) subsets.push_back(set);
+            return it->second;
+        };
+        dead_state = stateOf({});
+        start_state = stateOf(closure({number[start]}));
+
+        std::vector<std::vector<int>> targets(num_classes);
+        for (int d = 0; d < subsets.size(); d++) {
+            int rule = NO_RULE;
+            for (auto& target : targets) target.clear();
+            for (int s : subsets[d]) {
+                if (rule_of[s] != NO_RULE && (rule == NO_RULE || rule_of[s] < rule)) rule = rule_of[s];
+                for (const auto& [cls, t] : moves[s]) targets[cls].push_back(t);
+            }
+            accept.push_back(rule);
+            table.resize(subsets.size() * num_classes, dead_state);
+            for (int c = 0; c < num_classes; c++) {
+                table[d * num_classes + c] = targets[c].empty() ? dead_state : stateOf(closure(targets[c]));
+            }
+        }
+    }
+
+    /**
+     * @brief Moore minimization that keeps the rule tags
+     * Procedure
+     * 1. Start with one block per rule accepted, plus the non accepting block
+     * 2. Split blocks by the blocks of their targets until nothing changes
+     * 3. Every block becomes one state
+     */
+
+    void minimize() {
+        int n = accept.size();
+        std::vector<int> block(n);
+        for (int s = 0; s < n; s++) block[s] = accept[s] + 1;
+        int count = 0;
+        while (true) {
+            std::map<std::vector<int>, int> signature_block;
+            std::vector<int> next_block(n);
+            for (int s = 0; s < n; s++) {
+                std::vector<int> signature = {block[s]};
+                for (int c = 0; c < num_classes; c++) signature.push_back(block[table[s * num_classes + c]]);
+                next_block[s] = signature_block.emplace(signature, signature_block.size()).first->second;
+            }
+            block = next_block;
+            if (signature_block.size() == count) break;
+            count = signature_block.size();
+        }
+
+        std::vector<int32_t> minimized(count * num_classes);
+        std::vector<int> minimized_accept(count);
+        for (int s = 0; s < n; s++) {
+            minimized_accept[block[s]] = accept[s];
+            for (int c = 0; c < num_classes; c++) {
+                minimized[block[s] * num_classes + c] = block[table[s * num_classes + c]];
+            }
+        }
+        table = minimized;
+        accept = minimized_accept;
+        start_state = block[start_state];
+        dead_state = block[dead_state];
+    }
+};
@@ -0,0 +1,186 @@
+#pragma once
+#include "charClass.hpp"
+
+// UTF-8 patterns : code points are decoded by the lexer, but the automata keep
+// reading bytes, a code point class becomes a small NFA of byte range edges
+
+bool utf8_patterns = true; // false : every byte of a pattern is a literal, '.' and [^...] are byte sets
+
+const uint32_t MAX_CODE_POINT = 0x10FFFF;
+
+using CodePointRanges = std::vector<std::pair<uint32_t, uint32_t>>; // sorted, disjoint, not adjacent
+
+std::string encodeUtf8(uint32_t code_point) {
+    std::string bytes;
+    if (code_point < 0x80) {
+        bytes += char(code_point);
+    } else if (code_point < 0x800) {
+        bytes += char(0xC0 | code_point >> 6);
+        bytes += char(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        bytes += char(0xE0 | code_point >> 12);
+        bytes += char(0x80 | (code_point >> 6 & 0x3F));
+        bytes += char(0x80 | (code_point & 0x3F));
+    } else {
+        bytes += char(0xF0 | code_point >> 18);
+        bytes += char(0x80 | (code_point >> 12 & 0x3F));
+        bytes += char(0x80 | (code_point >> 6 & 0x3F));
+        bytes += char(0x80 | (code_point & 0x3F));
+    }
+    return bytes;
+}
+
+/**
+ * @brief Decode the code point starting at text[i]
+ * Overlong forms, surrogates and values above U+10FFFF are not valid
+ *
+ * @param text
+ * @param i moved to the last byte of the code point on success
+ * @return std::optional<uint32_t> empty if text[i] does not start a valid sequence
+ */
+
+std::optional<uint32_t> decodeUtf8(const std::string& text, int& i) {
+    unsigned char lead = text[i];
+    int length = lead < 0x80 ? 1 : lead >> 5 == 0x6 ? 2 : lead >> 4 == 0xE ? 3 : lead >> 3 == 0x1E ? 4 : 0;
+    if (length == 0 || i + length > text.size()) return std::nullopt;
+    uint32_t code_point = length == 1 ? lead : lead & (0x7F >> length);
+    for (int k = 1; k < length; k++) {
+        unsigned char next = text[i + k];
+        if (next >> 6 != 0x2) return std::nullopt;
+        code_point = code_point << 6 | (next & 0x3F);
+    }
+    static const uint32_t smallest[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (code_point < smallest[length] || code_point > MAX_CODE_POINT || (code_point >= 0xD800 && code_point <= 0xDFFF)) return std::nullopt;
+    i += length - 1;
+    return code_point;
+}
+
+CodePointRanges normalizeRanges(CodePointRanges ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    CodePointRanges merged;
+    for (const auto& [low, high] : ranges) {
+        if (!merged.empty() && low <= merged.back().second + 1) {
+            merged.back().second = std::max(merged.back().second, high);
+        } else {
+            merged.push_back({low, high});
+        }
+    }
+    return merged;
+}
+
+CodePointRanges complementRanges(const CodePointRanges& ranges) {
+    CodePointRanges complement;
+    uint32_t next = 0;
+    for (const auto& [low, high] : ranges) {
+        if (low > next) complement.push_back({next, low - 1});
+        next = high + 1;
+    }
+    if (next <= MAX_CODE_POINT) complement.push_back({next, MAX_CODE_POINT});
+    return complement;
+}
+
+// what '.' matches in a UTF-8 pattern, one code point but the newline
+CodePointRanges anyCodePointButNewline() {
+    return {{0, '\n' - 1}, {'\n' + 1, MAX_CODE_POINT}};
+}
+
+// ranges as token content : the UTF-8 of every low and high, UTF-8 delimits itself
+std::string rangesContent(const CodePointRanges& ranges) {
+    std::string content;
+    for (const auto& [low, high] : ranges) content += encodeUtf8(low) + encodeUtf8(high);
+    return content;
+}
+
+CodePointRanges contentRanges(const std::string& content) {
+    CodePointRanges ranges;
+    for (int i = 0; i < content.size(); i++) {
+        uint32_t low = *decodeUtf8(content, i);
+        i++;
+        uint32_t high = *decodeUtf8(content, i);
+        ranges.push_back({low, high});
+    }
+    return ranges;
+}
+
+// the class as a UTF-8 regex writes it, e.g. [a-zα-ω] or .
+std::string codePointRangesLabel(const CodePointRanges& ranges) {
+    auto printable = [](uint32_t code_point) { return code_point < 0x80 ? printableByte(code_point) : encodeUtf8(code_point); };
+    if (ranges == anyCodePointButNewline()) return ".";
+    if (ranges.size() == 1 && ranges[0].first == ranges[0].second) return printable(ranges[0].first);
+    std::string label = "[";
+    for (const auto& [low, high] : ranges) {
+        label += printable(low);
+        if (high != low) label += "-" + printable(high);
+    }
+    return label + "]";
+}
+
+using ByteRangeSequence = std::vector<std::pair<unsigned char, unsigned char>>;
+
+/**
+ * @brief Byte range sequences whose concatenations are exactly the UTF-8 of a code point range
+ * Procedure, the range is split until every piece is a product of byte ranges
+ * 1. surrogates are cut out
+ * 2. a range crossing an encoded length boundary (U+7F, U+7FF, U+FFFF) is split there
+ * 3. for the continuation bytes from the last one, a range whose low does not start
+ *    (or high does not end) a full block of 64^k code points is split at the block
+ * 4. a piece that remains encodes its low and high, byte k reads low[k] .. high[k]
+ *
+ * @param low
+ * @param high
+ * @return std::vector<ByteRangeSequence>
+ */
+
+std::vector<ByteRangeSequence> utf8Sequences(uint32_t low, uint32_t high) {
+    std::vector<ByteRangeSequence> sequences;
+    std::vector<std::pair<uint32_t, uint32_t>> pending = {{low, high}};
+    while (!pending.empty()) {
+        auto [lo, hi] = pending.back();
+        pending.pop_back();
+        if (lo > hi) continue;
+        if (lo < 0xE000 && hi > 0xD7FF) { // surrogates
+            pending.push_back({0xE000, hi});
+            pending.push_back({lo, 0xD7FF});
+            continue;
+        }
+        bool split = false;
+        for (uint32_t boundary : {0x7Fu, 0x7FFu, 0xFFFFu}) {
+            if (lo <= boundary && hi > boundary) {
+                pending.push_back({boundary + 1, hi});
+                pending.push_back({lo, boundary});
+                split = true;
+                break;
+            }
+        }
+        if (split) continue;
+        if (hi < 0x80) {
+            sequences.push_back({{(unsigned char)lo, (unsigned char)hi}});
+            continue;
+        }
+        for (int k = 1; k < 4 && !split; k++) {
+            uint32_t block = (1u << (6 * k)) - 1;
+            if ((lo & ~block) == (hi & ~block)) continue;
+            if ((lo & block) != 0) {
+                pending.push_back({(lo | block) + 1, hi});
+                pending.push_back({lo, lo | block});
+                split = true;
+            } else if ((hi & block) != block) {
+                pending.push_back({hi & ~block, hi});
+                pending.push_back({lo, (hi & ~block) - 1});
+                split = true;
+            }
+        }
+        if (split) continue;
+        std::string low_bytes = encodeUtf8(lo), high_bytes = encodeUtf8(hi);
+        ByteRangeSequence sequence;
+        for (int k = 0; k < low_bytes.size(); k++) sequence.push_back({low_bytes[k], high_bytes[k]});
+        sequences.push_back(sequence);
+    }
+    return sequences;
+}
+
+std::string byteRangeLabel(unsigned char low, unsigned char high) {
+    CharSet set;
+    for (int c = low; c <= high; c++) set.set(c);
+    return charSetLabel(set);
+}